@@ -0,0 +1,323 @@
+#include "BlockCompress.h"
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+static const uint32_t bc_magic = 0x315a4354; // "TCZ1"
+static const int bc_ebits = 11; // Bits of the block exponent
+static const int bc_ebias = 1023;
+static const int bc_intprec = 64;
+static const int bc_minexp = -1074;
+static const size_t bc_chunk = 256; // Blocks in a chunk
+static const uint64_t bc_nbmask = 0xaaaaaaaaaaaaaaaaull;
+
+/// Header of the compressed stream. It is followed by the sizes of chunks (in 64-bit words) and the chunks
+struct BlockCompressHeader {
+	uint32_t magic;
+	uint32_t nx, ny, nz, comp;
+	uint32_t mode;
+	int32_t minexp;
+	uint32_t maxbits;
+	uint64_t nblocks, nchunks;
+};
+
+class BitWriter {
+	std::vector<uint64_t>& words;
+	uint64_t buf;
+	int bits;
+public:
+	size_t total;
+	inline BitWriter(std::vector<uint64_t>& words_) : words(words_), buf(0), bits(0), total(0) {}
+	inline void write(uint64_t v, int n) {
+		if (n == 0) return;
+		if (n < 64) v &= (1ull << n) - 1;
+		buf |= v << bits;
+		int space = 64 - bits;
+		if (n >= space) {
+			words.push_back(buf);
+			buf = space < 64 ? v >> space : 0;
+			bits = n - space;
+		} else {
+			bits += n;
+		}
+		total += n;
+	}
+	inline uint64_t writeBits(uint64_t v, int n) { write(v, n); return n < 64 ? v >> n : 0; }
+	inline bool writeBit(bool b) { write(b, 1); return b; }
+	inline void pad(size_t n) {
+		for (; n >= 64; n -= 64) write(0, 64);
+		write(0, n);
+	}
+	inline void flush() {
+		if (bits > 0) words.push_back(buf);
+		buf = 0;
+		bits = 0;
+	}
+};
+
+class BitReader {
+	const uint64_t * words;
+	size_t size, pos;
+	uint64_t buf;
+	int bits;
+public:
+	size_t total;
+	inline BitReader(const uint64_t * words_, size_t size_) : words(words_), size(size_), pos(0), buf(0), bits(0), total(0) {}
+	inline uint64_t read(int n) {
+		if (n == 0) return 0;
+		uint64_t v = buf;
+		if (bits < n) {
+			uint64_t w = pos < size ? words[pos++] : 0;
+			v |= w << bits;
+			int used = n - bits;
+			buf = used < 64 ? w >> used : 0;
+			bits = 64 - used;
+		} else {
+			buf = n < 64 ? buf >> n : 0;
+			bits -= n;
+		}
+		if (n < 64) v &= (1ull << n) - 1;
+		total += n;
+		return v;
+	}
+	inline void skip(size_t n) {
+		for (; n >= 64; n -= 64) read(64);
+		read(n);
+	}
+};
+
+/// Order of the coefficients in a block (by sequency)
+static std::vector<int> makeBlockPerm() {
+	std::vector<int> perm(64);
+	for (int i=0; i<64; i++) perm[i] = i;
+	std::stable_sort(perm.begin(), perm.end(), [](int a, int b) {
+		int ax = a & 3, ay = (a >> 2) & 3, az = a >> 4;
+		int bx = b & 3, by = (b >> 2) & 3, bz = b >> 4;
+		int as = ax + ay + az, bs = bx + by + bz;
+		if (as != bs) return as < bs;
+		return ax*ax + ay*ay + az*az < bx*bx + by*by + bz*bz;
+	});
+	return perm;
+}
+
+static const int* blockPerm() {
+	static const std::vector<int> perm = makeBlockPerm();
+	return perm.data();
+}
+
+static inline void fwdLift(int64_t * p, int s) {
+	int64_t x = p[0], y = p[s], z = p[2*s], w = p[3*s];
+	x += w; x >>= 1; w -= x;
+	z += y; z >>= 1; y -= z;
+	x += z; x >>= 1; z -= x;
+	w += y; w >>= 1; y -= w;
+	w += y >> 1; y -= w >> 1;
+	p[0] = x; p[s] = y; p[2*s] = z; p[3*s] = w;
+}
+
+static inline void invLift(int64_t * p, int s) {
+	int64_t x = p[0], y = p[s], z = p[2*s], w = p[3*s];
+	y += w >> 1; w -= y >> 1;
+	y += w; w <<= 1; w -= y;
+	z += x; x <<= 1; x -= z;
+	y += z; z <<= 1; z -= y;
+	w += x; x <<= 1; x -= w;
+	p[0] = x; p[s] = y; p[2*s] = z; p[3*s] = w;
+}
+
+static void fwdXform(int64_t * p) {
+	for (int z=0; z<4; z++) for (int y=0; y<4; y++) fwdLift(p + 4*y + 16*z, 1);
+	for (int x=0; x<4; x++) for (int z=0; z<4; z++) fwdLift(p + 16*z + x, 4);
+	for (int y=0; y<4; y++) for (int x=0; x<4; x++) fwdLift(p + 4*y + x, 16);
+}
+
+static void invXform(int64_t * p) {
+	for (int y=0; y<4; y++) for (int x=0; x<4; x++) invLift(p + 4*y + x, 16);
+	for (int x=0; x<4; x++) for (int z=0; z<4; z++) invLift(p + 16*z + x, 4);
+	for (int z=0; z<4; z++) for (int y=0; y<4; y++) invLift(p + 4*y + 16*z, 1);
+}
+
+/// Number of bit planes needed for the accuracy
+static inline int blockPrecision(int emax, int minexp) {
+	return std::min(bc_intprec, std::max(0, emax - minexp + 2*(3+1)));
+}
+
+/// Embedded coding of the bit planes, with group tests for the zero coefficients
+static void encodeInts(BitWriter& s, uint64_t bits, int maxprec, const uint64_t * data) {
+	const int size = 64;
+	int kmin = bc_intprec > maxprec ? bc_intprec - maxprec : 0;
+	int k, n;
+	for (k = bc_intprec, n = 0; bits && k-- > kmin;) {
+		uint64_t x = 0;
+		for (int i=0; i<size; i++) x += ((data[i] >> k) & 1u) << i;
+		int m = std::min<uint64_t>(n, bits);
+		bits -= m;
+		x = s.writeBits(x, m);
+		for (; n < size && bits && (bits--, s.writeBit(!!x)); x >>= 1, n++)
+			for (; n < size - 1 && bits && (bits--, !s.writeBit(x & 1u)); x >>= 1, n++)
+				;
+	}
+}
+
+static void decodeInts(BitReader& s, uint64_t bits, int maxprec, uint64_t * data) {
+	const int size = 64;
+	int kmin = bc_intprec > maxprec ? bc_intprec - maxprec : 0;
+	int k, n;
+	for (int i=0; i<size; i++) data[i] = 0;
+	for (k = bc_intprec, n = 0; bits && k-- > kmin;) {
+		int m = std::min<uint64_t>(n, bits);
+		bits -= m;
+		uint64_t x = s.read(m);
+		for (; n < size && bits && (bits--, s.read(1)); x += (uint64_t) 1 << n++)
+			for (; n < size - 1 && bits && (bits--, !s.read(1)); n++)
+				;
+		for (int i=0; x; i++, x >>= 1) data[i] += (x & 1u) << k;
+	}
+}
+
+static void encodeBlock(BitWriter& s, const double * f, int minexp, uint32_t maxbits, bool fixed) {
+	size_t start = s.total;
+	double fmax = 0;
+	for (int i=0; i<64; i++) fmax = std::max(fmax, fabs(f[i]));
+	int emax = 0;
+	if (fmax > 0) {
+		frexp(fmax, &emax);
+		emax = std::max(emax, 1 - bc_ebias);
+	}
+	int maxprec = fmax > 0 ? blockPrecision(emax, minexp) : 0;
+	if (maxprec == 0) {
+		s.write(0, 1);
+	} else {
+		s.write(1, 1);
+		s.write(emax + bc_ebias, bc_ebits);
+		int64_t iblock[64];
+		for (int i=0; i<64; i++) iblock[i] = (int64_t) ldexp(f[i], bc_intprec - 2 - emax);
+		fwdXform(iblock);
+		const int* perm = blockPerm();
+		uint64_t ublock[64];
+		for (int i=0; i<64; i++) ublock[i] = ((uint64_t) iblock[perm[i]] + bc_nbmask) ^ bc_nbmask;
+		encodeInts(s, maxbits - 1 - bc_ebits, maxprec, ublock);
+	}
+	if (fixed) s.pad(maxbits - (s.total - start));
+}
+
+static void decodeBlock(BitReader& s, double * f, int minexp, uint32_t maxbits, bool fixed) {
+	size_t start = s.total;
+	if (! s.read(1)) {
+		for (int i=0; i<64; i++) f[i] = 0;
+	} else {
+		int emax = (int) s.read(bc_ebits) - bc_ebias;
+		int maxprec = blockPrecision(emax, minexp);
+		uint64_t ublock[64];
+		decodeInts(s, maxbits - 1 - bc_ebits, maxprec, ublock);
+		const int* perm = blockPerm();
+		int64_t iblock[64];
+		for (int i=0; i<64; i++) iblock[perm[i]] = (int64_t) ((ublock[i] ^ bc_nbmask) - bc_nbmask);
+		invXform(iblock);
+		for (int i=0; i<64; i++) f[i] = ldexp((double) iblock[i], emax - (bc_intprec - 2));
+	}
+	if (fixed) s.skip(maxbits - (s.total - start));
+}
+
+/// Position of a block in the field
+struct BlockIndex {
+	int c, x, y, z;
+	inline BlockIndex(size_t b, int nx, int ny, int nz) {
+		int bx = (nx + 3) / 4, by = (ny + 3) / 4, bz = (nz + 3) / 4;
+		size_t nb = (size_t) bx * by * bz;
+		c = b / nb;
+		b = b % nb;
+		x = 4 * (b % bx);
+		y = 4 * ((b / bx) % by);
+		z = 4 * (b / bx / by);
+	}
+};
+
+static inline size_t blockCount(int nx, int ny, int nz, int comp) {
+	return (size_t) comp * ((nx + 3) / 4) * ((ny + 3) / 4) * ((nz + 3) / 4);
+}
+
+size_t BlockCompressor::Compress(const double * in, int nx, int ny, int nz, int comp, std::vector<unsigned char>& out) const {
+	BlockCompressHeader h;
+	h.magic = bc_magic;
+	h.nx = nx; h.ny = ny; h.nz = nz; h.comp = comp;
+	h.mode = mode;
+	if (mode == MODE_RATE) {
+		h.minexp = bc_minexp;
+		h.maxbits = std::max< uint32_t >(lrint(rate * 64), 1 + bc_ebits + 1);
+	} else {
+		h.minexp = tolerance > 0 ? std::max< int >(floor(log2(tolerance)), bc_minexp) : bc_minexp;
+		h.maxbits = 1 + bc_ebits + 2 * 64 * 64;
+	}
+	h.nblocks = blockCount(nx, ny, nz, comp);
+	h.nchunks = (h.nblocks + bc_chunk - 1) / bc_chunk;
+	std::vector< std::vector<uint64_t> > chunks(h.nchunks);
+	bool fixed = mode == MODE_RATE;
+	#pragma omp parallel for schedule(dynamic)
+	for (long ch = 0; ch < (long) h.nchunks; ch++) {
+		BitWriter s(chunks[ch]);
+		size_t end = std::min< size_t >(h.nblocks, (ch + 1) * bc_chunk);
+		for (size_t b = ch * bc_chunk; b < end; b++) {
+			BlockIndex bi(b, nx, ny, nz);
+			double f[64];
+			for (int k=0; k<4; k++) for (int j=0; j<4; j++) for (int i=0; i<4; i++) {
+				int x = std::min(bi.x + i, nx - 1), y = std::min(bi.y + j, ny - 1), z = std::min(bi.z + k, nz - 1);
+				f[i + 4*j + 16*k] = in[bi.c + comp * (x + (size_t) nx * (y + (size_t) ny * z))];
+			}
+			encodeBlock(s, f, h.minexp, h.maxbits, fixed);
+		}
+		s.flush();
+	}
+	std::vector<uint64_t> sizes(h.nchunks);
+	size_t words = 0;
+	for (size_t ch = 0; ch < h.nchunks; ch++) {
+		sizes[ch] = chunks[ch].size();
+		words += sizes[ch];
+	}
+	out.resize(sizeof(h) + sizeof(uint64_t) * (h.nchunks + words));
+	unsigned char * ptr = out.data();
+	memcpy(ptr, &h, sizeof(h)); ptr += sizeof(h);
+	memcpy(ptr, sizes.data(), sizeof(uint64_t) * h.nchunks); ptr += sizeof(uint64_t) * h.nchunks;
+	for (size_t ch = 0; ch < h.nchunks; ch++) {
+		memcpy(ptr, chunks[ch].data(), sizeof(uint64_t) * sizes[ch]);
+		ptr += sizeof(uint64_t) * sizes[ch];
+	}
+	return out.size();
+}
+
+int BlockCompressor::Decompress(const unsigned char * in, size_t len, int nx, int ny, int nz, int comp, double * out) {
+	BlockCompressHeader h;
+	if (len < sizeof(h)) return -1;
+	memcpy(&h, in, sizeof(h));
+	if (h.magic != bc_magic) return -1;
+	if (h.mode != MODE_ACCURACY && h.mode != MODE_RATE) return -1;
+	if (h.maxbits < (uint32_t) bc_ebits + 2) return -1; // a block needs its flag, exponent and at least one bit
+	if ((int) h.nx != nx || (int) h.ny != ny || (int) h.nz != nz || (int) h.comp != comp) return -1;
+	if (h.nblocks != blockCount(nx, ny, nz, comp)) return -1;
+	if (h.nchunks != (h.nblocks + bc_chunk - 1) / bc_chunk) return -1;
+	if (len < sizeof(h) + sizeof(uint64_t) * h.nchunks) return -1;
+	size_t nwords = (len - sizeof(h)) / sizeof(uint64_t);
+	std::vector<uint64_t> words(nwords);
+	memcpy(words.data(), in + sizeof(h), sizeof(uint64_t) * nwords);
+	std::vector<size_t> offset(h.nchunks + 1);
+	offset[0] = h.nchunks;
+	for (size_t ch = 0; ch < h.nchunks; ch++) offset[ch+1] = offset[ch] + words[ch];
+	if (offset[h.nchunks] > nwords) return -1;
+	bool fixed = h.mode == MODE_RATE;
+	#pragma omp parallel for schedule(dynamic)
+	for (long ch = 0; ch < (long) h.nchunks; ch++) {
+		BitReader s(words.data() + offset[ch], offset[ch+1] - offset[ch]);
+		size_t end = std::min< size_t >(h.nblocks, (ch + 1) * bc_chunk);
+		for (size_t b = ch * bc_chunk; b < end; b++) {
+			BlockIndex bi(b, nx, ny, nz);
+			double f[64];
+			decodeBlock(s, f, h.minexp, h.maxbits, fixed);
+			for (int k=0; k<4; k++) for (int j=0; j<4; j++) for (int i=0; i<4; i++) {
+				int x = bi.x + i, y = bi.y + j, z = bi.z + k;
+				if (x < nx && y < ny && z < nz) out[bi.c + comp * (x + (size_t) nx * (y + (size_t) ny * z))] = f[i + 4*j + 16*k];
+			}
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,33 @@
+#ifndef BLOCKCOMPRESS_H
+#define BLOCKCOMPRESS_H
+
+#include <vector>
+#include <stddef.h>
+
+/// Error-bounded lossy compression of fields
+/**
+	The field is split into 4x4x4 blocks (the blocks at the edges are padded
+	by repeating the last value). Every block is converted to integers with
+	a common exponent, decorrelated with an integer lifting transform, and
+	coded bit plane by bit plane, starting from the most significant one.
+	The coding stops at the bit plane below the requested accuracy
+	(fixed-accuracy mode), or after a fixed number of bits per value
+	(fixed-rate mode). Blocks are grouped in chunks, which are compressed
+	and decompressed in parallel.
+*/
+class BlockCompressor {
+public:
+	enum mode_t { MODE_ACCURACY = 1, MODE_RATE = 2 };
+	mode_t mode;
+	double tolerance; ///< Maximal absolute error (fixed-accuracy mode)
+	double rate; ///< Bits per value (fixed-rate mode)
+	inline BlockCompressor() : mode(MODE_ACCURACY), tolerance(0), rate(0) {}
+	inline void setAccuracy(double tolerance_) { mode = MODE_ACCURACY; tolerance = tolerance_; }
+	inline void setRate(double rate_) { mode = MODE_RATE; rate = rate_; }
+	/// Compresses a field of nx x ny x nz nodes with comp components (interleaved)
+	size_t Compress(const double * in, int nx, int ny, int nz, int comp, std::vector<unsigned char>& out) const;
+	/// Decompresses a field, checking that it has the expected size. Returns -1 on error
+	static int Decompress(const unsigned char * in, size_t len, int nx, int ny, int nz, int comp, double * out);
+};
+
+#endif // BLOCKCOMPRESS_H
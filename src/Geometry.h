@@ -3,6 +3,7 @@
 
 #include "unit.h"
 #include <map>
+#include <vector>
 /// STL triangle structure
 #ifdef _WIN32
   struct STL_tri {
@@ -26,7 +27,8 @@ enum draw_mode {
 class Geometry {
 public:
   flag_t * geom; ///< Main table of flags/NodeType's
-  cut_t * Q;
+  int * Qidx; ///< Index of the cuts of each node in Q (-1 for nodes without cuts)
+  std::vector<cut_t> Q; ///< Cuts of the nodes listed in Qidx (26 consecutive values per node)
   lbRegion region; ///< Lattive region
   lbRegion totalregion; ///< Global Lattive region
   UnitEnv units; ///< Units object for unit calculations
@@ -57,6 +59,7 @@ private:
   double val_d(pugi::xml_attribute attr);
   flag_t Dot(int x, int y, int z);
   void ActivateCuts();
+  cut_t * NodeCuts(size_t k);
 };
 
 #endif
@@ -0,0 +1,272 @@
+#include "Consts.h"
+#include "Global.h"
+#include "HaloExchange.h"
+#include <string.h>
+
+HaloExchange::HaloExchange() : comm(MPI_COMM_NULL), graph(MPI_COMM_NULL), nodecomm(MPI_COMM_NULL), win(MPI_WIN_NULL),
+	myflags(NULL), mybase(NULL), epoch(0), current(NULL), collective(MPI_REQUEST_NULL), received(0), shmreceived(0) {}
+
+/// Register a buffer to be send to "to" and received from "from"
+void HaloExchange::Add(int to, int from, size_t size_) {
+	nodeout.push_back(to);
+	nodein.push_back(from);
+	size.push_back(size_);
+}
+
+/// Finalize the list of buffers
+/**
+  Divides the buffers between the shared window and MPI.
+  Creates the graph communicator for the neighbourhood collectives (if enabled).
+  Buffers with the same pair of processors are matched in the order they were added.
+*/
+void HaloExchange::Init(MPI_Comm comm_) {
+	comm = comm_;
+	int n = number();
+	InitShared();
+	std::vector<bool> shm(n, false);
+	for (size_t k = 0; k < shmout.size(); k++) shm[shmout[k]] = true;
+	for (int i = 0; i < n; i++) if (! shm[i]) mpiidx.push_back(i);
+#ifdef CROSS_MPI_NEIGHBOR
+	int m = mpiidx.size();
+	std::vector<int> srcs(m), dsts(m);
+	counts.resize(m);
+	types.assign(m, MPI_BYTE);
+	for (int k = 0; k < m; k++) {
+		srcs[k] = nodein[mpiidx[k]];
+		dsts[k] = nodeout[mpiidx[k]];
+		counts[k] = size[mpiidx[k]];
+	}
+	MPI_Dist_graph_create_adjacent(comm,
+		m, srcs.data(), MPI_UNWEIGHTED,
+		m, dsts.data(), MPI_UNWEIGHTED,
+		MPI_INFO_NULL, 0, &graph);
+	debug2("Created neighbourhood communicator with %d edges\n", m);
+#endif
+}
+
+/// Allocate the shared window for the buffers exchanged within a host
+/**
+  Buffer i goes through the window if the processors on both of its ends
+  (this one and the neighbour) share the host. It is decided separately
+  for the sending and receiving side, so both ends of any pair agree.
+*/
+void HaloExchange::InitShared() {
+#ifndef CROSS_MPI_NOSHARED
+	int n = number();
+	MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &nodecomm);
+	MPI_Group group, nodegroup;
+	MPI_Comm_group(comm, &group);
+	MPI_Comm_group(nodecomm, &nodegroup);
+	std::vector<int> out_node(n), in_node(n);
+	MPI_Group_translate_ranks(group, n, nodeout.data(), nodegroup, out_node.data());
+	MPI_Group_translate_ranks(group, n, nodein.data(), nodegroup, in_node.data());
+	MPI_Group_free(&group);
+	MPI_Group_free(&nodegroup);
+
+	MPI_Aint winsize = n * sizeof(Flags);
+	std::vector<size_t> offset(n, 0);
+	for (int i = 0; i < n; i++) {
+		if (out_node[i] != MPI_UNDEFINED) {
+			shmout.push_back(i);
+			winsize = (winsize + 63) / 64 * 64;
+			offset[i] = winsize;
+			winsize += size[i];
+		}
+		if (in_node[i] != MPI_UNDEFINED) shmin.push_back(i);
+	}
+	MPI_Win_allocate_shared(winsize, 1, MPI_INFO_NULL, nodecomm, &mybase, &win);
+	MPI_Win_lock_all(MPI_MODE_NOCHECK, win);
+	myflags = (Flags*) mybase;
+	for (int i = 0; i < n; i++) {
+		myflags[i].ready = 0;
+		myflags[i].consumed = 0;
+		myflags[i].offset = offset[i];
+	}
+	MPI_Win_sync(win);
+	MPI_Barrier(nodecomm);
+	MPI_Win_sync(win);
+	peerflags.resize(shmin.size());
+	peerbase.resize(shmin.size());
+	for (size_t k = 0; k < shmin.size(); k++) {
+		MPI_Aint sz;
+		int disp;
+		char * base;
+		MPI_Win_shared_query(win, in_node[shmin[k]], &sz, &disp, &base);
+		peerbase[k] = base;
+		peerflags[k] = (Flags*) base;
+	}
+	debug2("Halo exchange: %d buffers through shared memory, %d through MPI\n", (int) shmout.size(), n - (int) shmout.size());
+#endif
+}
+
+/// Address of the buffer i in the shared window (or NULL if it goes through MPI)
+/**
+  If the data to be send is placed there directly, no copy is needed
+*/
+void * HaloExchange::Shared(int i) {
+	if (myflags == NULL) return NULL;
+	if (myflags[i].offset == 0) return NULL;
+	return mybase + myflags[i].offset;
+}
+
+/// Find (or create) persistent requests for a specific set of buffers
+HaloExchange::Plan * HaloExchange::getPlan(void * const * out, void * const * in) {
+	int m = mpiidx.size();
+	for (size_t k = 0; k < plans.size(); k++) {
+		Plan& p = plans[k];
+		bool same = true;
+		for (int j = 0; j < m; j++) {
+			int i = mpiidx[j];
+			if ((p.out[j] != out[i]) || (p.in[j] != in[i])) { same = false; break; }
+		}
+		if (same) return &p;
+	}
+	debug2("Creating halo exchange plan %d\n", (int) plans.size());
+	Plan p;
+	for (int j = 0; j < m; j++) {
+		p.out.push_back(out[mpiidx[j]]);
+		p.in.push_back(in[mpiidx[j]]);
+	}
+#ifdef CROSS_MPI_NEIGHBOR
+	p.outdisp.resize(m);
+	p.indisp.resize(m);
+	for (int j = 0; j < m; j++) {
+		MPI_Get_address(p.out[j], &p.outdisp[j]);
+		MPI_Get_address(p.in[j], &p.indisp[j]);
+	}
+#else
+	p.send.resize(m);
+	p.recv.resize(m);
+	for (int j = 0; j < m; j++) {
+		int i = mpiidx[j];
+		MPI_Recv_init(p.in[j], size[i], MPI_BYTE, nodein[i], i, comm, &p.recv[j]);
+		MPI_Send_init(p.out[j], size[i], MPI_BYTE, nodeout[i], i, comm, &p.send[j]);
+	}
+#endif
+	plans.push_back(p);
+	return &plans.back();
+}
+
+/// Start the exchange of buffers
+/**
+  \param out Table of addresses of the buffers to send
+  \param in Table of addresses of the buffers to receive to
+*/
+void HaloExchange::Start(void * const * out, void * const * in) {
+	int n = number();
+	if (n == 0) return;
+	epoch++;
+	received = 0;
+	shmreceived = 0;
+	curout.assign(out, out + n);
+	curin.assign(in, in + n);
+	int m = mpiidx.size();
+	if (m > 0) {
+		current = getPlan(out, in);
+#ifdef CROSS_MPI_NEIGHBOR
+		MPI_Ineighbor_alltoallw(MPI_BOTTOM, counts.data(), current->outdisp.data(), types.data(),
+			MPI_BOTTOM, counts.data(), current->indisp.data(), types.data(), graph, &collective);
+#else
+		MPI_Startall(m, current->recv.data());
+		MPI_Startall(m, current->send.data());
+#endif
+	}
+	for (size_t k = 0; k < shmout.size(); k++) {
+		int i = shmout[k];
+		void * buf = Shared(i);
+		if (out[i] != buf) memcpy(buf, out[i], size[i]);
+	}
+	if (shmout.size() > 0) {
+		MPI_Win_sync(win);
+		for (size_t k = 0; k < shmout.size(); k++) myflags[shmout[k]].ready = epoch;
+	}
+}
+
+/// Copy out a buffer from the window of the source
+void HaloExchange::ReceiveShared(int k) {
+	int i = shmin[k];
+	Flags& f = peerflags[k][i];
+	while (f.ready < epoch) MPI_Win_sync(win);
+	MPI_Win_sync(win);
+	memcpy(curin[i], peerbase[k] + f.offset, size[i]);
+	MPI_Win_sync(win);
+	f.consumed = epoch;
+}
+
+/// Wait for any of the received buffers
+/**
+  \return Index of the buffer that was received, or -1 if all were already received
+*/
+int HaloExchange::WaitAny() {
+	int n = number();
+	if (received >= n) return -1;
+	if (shmreceived < (int) shmin.size()) {
+		ReceiveShared(shmreceived);
+		received++;
+		return shmin[shmreceived++];
+	}
+#ifdef CROSS_MPI_NEIGHBOR
+	if (received == shmreceived) MPI_Wait(&collective, MPI_STATUS_IGNORE);
+	return mpiidx[(received++) - shmreceived];
+#else
+	int m = mpiidx.size();
+	int j;
+	MPI_Waitany(m, current->recv.data(), &j, MPI_STATUS_IGNORE);
+	if (j == MPI_UNDEFINED) return -1;
+	received++;
+	return mpiidx[j];
+#endif
+}
+
+/// Wait for all the received buffers
+void HaloExchange::WaitRecv() {
+	for (int i = WaitAny(); i >= 0; i = WaitAny());
+}
+
+/// Wait for the sending to finish
+/**
+  Also waits for the neighbours on the same host to copy out the data,
+  so it is safe to overwrite the buffers in the shared window.
+*/
+void HaloExchange::WaitSend() {
+	int m = mpiidx.size();
+	if (m > 0) {
+#ifdef CROSS_MPI_NEIGHBOR
+		if (received == shmreceived) {
+			MPI_Wait(&collective, MPI_STATUS_IGNORE);
+			received = shmreceived + m;
+		}
+#else
+		MPI_Waitall(m, current->send.data(), MPI_STATUSES_IGNORE);
+#endif
+	}
+	for (size_t k = 0; k < shmout.size(); k++) {
+		while (myflags[shmout[k]].consumed < epoch) MPI_Win_sync(win);
+	}
+}
+
+/// Total number of bytes send in one exchange
+size_t HaloExchange::bytes() const {
+	size_t ret = 0;
+	for (size_t i = 0; i < size.size(); i++) ret += size[i];
+	return ret;
+}
+
+/// Free all the persistent requests and the shared window
+void HaloExchange::Free() {
+	for (size_t k = 0; k < plans.size(); k++) {
+		Plan& p = plans[k];
+		for (size_t i = 0; i < p.send.size(); i++) MPI_Request_free(&p.send[i]);
+		for (size_t i = 0; i < p.recv.size(); i++) MPI_Request_free(&p.recv[i]);
+	}
+	plans.clear();
+	current = NULL;
+	if (graph != MPI_COMM_NULL) MPI_Comm_free(&graph);
+	if (win != MPI_WIN_NULL) {
+		MPI_Win_unlock_all(win);
+		MPI_Win_free(&win);
+		myflags = NULL;
+		mybase = NULL;
+	}
+	if (nodecomm != MPI_COMM_NULL) MPI_Comm_free(&nodecomm);
+}
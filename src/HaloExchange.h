@@ -0,0 +1,75 @@
+#ifndef HALOEXCHANGE_H
+#define HALOEXCHANGE_H
+
+#include <mpi.h>
+#include <stdlib.h>
+#include <vector>
+
+/// Exchange of the margin (halo) buffers between processors
+/**
+  The list of buffers (destination, source and size) is fixed at Lattice::MPIInit.
+  For every distinct set of send/receive addresses a set of persistent
+  requests (MPI_Send_init/MPI_Recv_init) is created once and then only
+  started with MPI_Startall. On CPU the FTabs margins are used directly,
+  so there are only a few such sets (one per Snapshot).
+  With CROSS_MPI_NEIGHBOR the exchange is done with a single
+  MPI_Ineighbor_alltoallw on a distributed graph communicator.
+
+  Buffers exchanged with processors on the same host go through
+  an MPI-3 shared window (unless CROSS_MPI_NOSHARED is defined).
+  Buffer i is placed in the window of the sender, the receiver copies it
+  out directly when the "ready" flag reaches the current epoch and marks
+  it "consumed". A buffer with index i is matched with the buffer i
+  of the neighbour (as are the MPI tags).
+*/
+class HaloExchange {
+	struct Plan {
+		std::vector<void*> out, in;
+		std::vector<MPI_Request> send, recv;
+		std::vector<MPI_Aint> outdisp, indisp;
+	};
+	/// Header at the begining of every shared window
+	struct Flags {
+		volatile long long int ready;
+		volatile long long int consumed;
+		size_t offset;
+	};
+	MPI_Comm comm;
+	MPI_Comm graph; ///< Graph communicator for neighbourhood collectives
+	MPI_Comm nodecomm; ///< Processors on the same host
+	MPI_Win win; ///< Shared window with the buffers send to the same host
+	std::vector<int> nodeout, nodein;
+	std::vector<size_t> size;
+	std::vector<int> mpiidx; ///< Buffers going through MPI
+	std::vector<int> shmout, shmin; ///< Buffers send and received through the shared window
+	std::vector<Flags*> peerflags; ///< Headers of the windows of the sources (for shmin)
+	std::vector<char*> peerbase; ///< Base of the windows of the sources (for shmin)
+	Flags * myflags;
+	char * mybase;
+	long long int epoch;
+	std::vector<int> counts; ///< Sizes for the collective (have to live till it completes)
+	std::vector<MPI_Datatype> types;
+	std::vector<Plan> plans;
+	Plan * current;
+	std::vector<void*> curout, curin;
+	MPI_Request collective;
+	int received, shmreceived;
+	Plan * getPlan(void * const * out, void * const * in);
+	void InitShared();
+	void ReceiveShared(int k);
+public:
+	HaloExchange();
+	void Add(int to, int from, size_t size);
+	void Init(MPI_Comm comm_);
+	void * Shared(int i);
+	void Start(void * const * out, void * const * in);
+	int WaitAny();
+	void WaitRecv();
+	void WaitSend();
+	void Free();
+	inline int number() const { return size.size(); }
+	inline int numberShared() const { return shmout.size(); }
+	size_t bytes() const;
+};
+
+#endif
@@ -28,3 +28,17 @@ int Design::Finish () {
 int Design::Type() { return HANDLER_DESIGN; }
 
 
+
+/// By default the whole parameter vector of a Design is kept on the 0-rank process
+int Design::NumberOfLocalParameters () {
+		int n = NumberOfParameters();
+		if (solver->mpi_rank == 0) return n;
+		return 0;
+	}
+
+
+int Design::LocalParameters (int type, double * tab) {
+		if (solver->mpi_rank == 0) return Parameters(type, tab);
+		return Parameters(type, NULL);
+	}
+
@@ -12,6 +12,8 @@ int DoIt ();
 int Init ();
 int Finish ();
 int Type();
+int NumberOfLocalParameters ();
+int LocalParameters (int type, double * tab);
 };
 
 #endif // DESIGN_H
@@ -3,8 +3,26 @@
 int GenericOptimizer::Init () {
 		GenericAction::Init();
 		Pars = NumberOfParameters();
-		int ret;
+		int ret, all;
 		DEBUG_M;
+		if (Distributed()) {
+			// All processors run the optimizer, each on its part of the parameter vector
+			LocalPars = NumberOfLocalParameters();
+			ret = OptimizerInit();
+			MPI_Allreduce( &ret, &all, 1, MPI_INT, MPI_MAX, MPMD.local );
+			if (all) {
+				ERROR("Failed to initialize Optimizer");
+				return -1;
+			}
+			ret = OptimizerRun();
+			MPI_Allreduce( &ret, &all, 1, MPI_INT, MPI_MAX, MPMD.local );
+			if (all) {
+				ERROR("Failed to run Optimizer");
+				return -1;
+			}
+			MPI_Barrier(MPMD.local);
+			return 0;
+		}
 		ret = OptimizerInit();
 		MPI_Bcast( &ret, 1, MPI_INT, 0, solver->mpi_comm );
 		if (ret) {
@@ -59,6 +77,35 @@ int GenericOptimizer::Execute (const double * x, double * grad, double * f) {
 
 
 
+/// Evaluate the objective and gradient with a partitioned parameter vector
+/**
+	Called on all the processors at the same time, with x and grad
+	being the local parts of the vectors (see NumberOfLocalParameters)
+*/
+int GenericOptimizer::ExecuteLocal (const double * x, double * grad, double * f) {
+		DEBUG_M;
+		solver->opt_iter++;
+		output("------- Optimization iteration %3d -------\n", solver->opt_iter);
+		SetLocalParameters(x);
+		int old_iter = solver->iter_type;
+		if (grad == NULL) {
+			output("No need for the gradient\n");
+			solver->iter_type |= ITER_SKIPGRAD;
+		}
+		if (GenericAction::ExecuteInternal()) return -1;
+		solver->iter_type = old_iter;
+		everyIter = solver->iter - startIter;
+		if (grad != NULL) GetLocalGradient(grad);
+		double obj = solver->lattice->getObjective();
+		MPI_Bcast( &obj, 1, MPI_DOUBLE, 0, MPMD.local );
+		if (f != NULL) {
+			*f = obj;
+			output("Evaluated objective: %lg\n", *f);
+		}
+		return 0;
+	}
+
+
 double FOptimize(unsigned int n, const double * x, double * grad, void * data) {
 	GenericOptimizer * obj = (GenericOptimizer *) data;
 	assert(n == (unsigned int)obj->Pars);
@@ -97,3 +144,4 @@ double FMaterialLess(unsigned int n, const double * x, double * grad, void * dat
 int GenericOptimizer::OptimizerInit() { ERROR("Called Generic Optimizer virtual Init function"); return -1; }
 int GenericOptimizer::OptimizerRun() { ERROR("Called Generic Optimizer virtual Run function"); return -1; }
 int GenericOptimizer::OptimizerExit() { ERROR("Called Generic Optimizer virtual Exit function"); return -1; }
+int GenericOptimizer::Distributed() { return 0; }
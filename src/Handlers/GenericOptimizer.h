@@ -14,12 +14,15 @@ double FMaterialLess(unsigned int n, const double * x, double * grad, void * dat
 class  GenericOptimizer  : public  GenericAction  {
 	public:
 	int Pars;
+	int LocalPars;
 	double material;
 	virtual int OptimizerInit();
 	virtual int OptimizerRun();
 	virtual int OptimizerExit();
+	virtual int Distributed();
 int Init ();
 int Execute (const double * x, double * grad, double * f);
+int ExecuteLocal (const double * x, double * grad, double * f);
 	friend double FOptimize(unsigned int n, const double * x, double * grad, void * data);
 	friend double FMaterialMore(unsigned int n, const double * x, double * grad, void * data);
 	friend double FMaterialLess(unsigned int n, const double * x, double * grad, void * data);
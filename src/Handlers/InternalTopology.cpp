@@ -38,5 +38,33 @@ int InternalTopology::Parameters (int type, double * tab) {
 	};
 
 
+int InternalTopology::NumberOfLocalParameters () {
+		NumberOfParameters();
+		return solver->Par_size;
+	};
+
+
+int InternalTopology::LocalParameters (int type, double * tab) {
+		switch(type){
+		case PAR_GET:
+			return solver->getLocalPar(tab);
+		case PAR_SET:
+			return solver->setLocalPar(tab);
+		case PAR_GRAD:
+			return solver->getLocalDPar(tab);
+		case PAR_UPPER:
+			for (int i=0;i<solver->Par_size;i++) tab[i]=1;
+			return 0;
+		case PAR_LOWER:
+			for (int i=0;i<solver->Par_size;i++) tab[i]=0;
+			return 0;
+		default:
+			ERROR("Unknown type %d in call to LocalParameters in %s\n",type,node.name());
+			exit(-1);
+		}
+		return -1;	
+	};
+
+
 // Register the handler (basing on xmlname) in the Handler Factory
 template class HandlerFactory::Register< GenericAsk< InternalTopology > >;
@@ -14,6 +14,8 @@ public:
 int Init ();
 int NumberOfParameters ();
 int Parameters (int type, double * tab);
+int NumberOfLocalParameters ();
+int LocalParameters (int type, double * tab);
 };
 
 #endif // INTERNALTOPOLOGY_H
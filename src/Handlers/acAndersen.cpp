@@ -1,25 +1,92 @@
 #include "acAndersen.h"
 std::string acAndersen::xmlname = "Andersen";
 #include "../HandlerFactory.h"
+#include <vector>
 
-
-template <typename T>
-void rotate(T* tab, int len) {
-        if (len < 1) return;
-        T last = tab[len-1];
-        for (int i = len-1; i > 0; i--) {
-                tab[i] = tab[i-1];
+/// Make the residual in slot head and its products with the last d residuals
+/**
+	Computes e[head] = e[head] - x[head] and all the dot products
+	of e[head] with the residuals in the history in one pass,
+	followed by a single MPI reduction.
+	dots[i] is the product with the residual saved i steps ago.
+*/
+int acAndersen::GramRow(int head, int d, double * dots) {
+        std::vector<real_t *> hist(d);
+        for (int i=0; i<d; i++) {
+                hist[i] = e[(head - i + directions) % directions];
+                dots[i] = 0;
+        }
+        real_t * eh = e[head];
+        real_t * xh = x[head];
+        #pragma omp parallel for reduction(+:dots[:d]) schedule(static)
+        for (size_t k=0; k<n; k++) {
+                double ek = eh[k] - xh[k];
+                eh[k] = ek;
+                for (int i=0; i<d; i++) dots[i] += ek*hist[i][k];
         }
-        tab[0] = last;
+        MPI_Allreduce ( MPI_IN_PLACE, dots, d, MPI_DOUBLE, MPI_SUM, solver->mpi_comm );
+        for (int i=0; i<d; i++) {
+                int s = (head - i + directions) % directions;
+                G[head*directions + s] = dots[i];
+                G[s*directions + head] = dots[i];
+        }
+        return 0;
 }
 
-double acAndersen::skal(real_t * a, real_t * b) {
-        double sum=0;
-        for (size_t k=0; k<n; k++) sum += a[k]*b[k];
-        // TODO: MPI scatter gather
-        double gsum=0;
-        MPI_Allreduce ( &sum, &gsum, 1, MPI_DOUBLE, MPI_SUM, solver->mpi_comm );
-        return gsum;
+/// Mixing coefficients of the last d states
+/**
+	Minimizes the norm of the combined residual with coefficients summing to 1,
+	by solving the (regularized) Gram system with Cholesky decomposition.
+	Returns the number of states used (older ones are dropped if the system is singular).
+*/
+int acAndersen::Coefficients(int head, int d, double * c) {
+        std::vector<double> A(d*d);
+        for (; d > 1; d--) {
+                double reg = 0;
+                for (int i=0; i<d; i++) {
+                        int si = (head - i + directions) % directions;
+                        for (int j=0; j<d; j++) {
+                                int sj = (head - j + directions) % directions;
+                                A[i*d+j] = G[si*directions + sj];
+                        }
+                        if (A[i*d+i] > reg) reg = A[i*d+i];
+                }
+                reg *= 1e-12;
+                for (int i=0; i<d; i++) A[i*d+i] += reg;
+                bool ok = true;
+                for (int j=0; j<d && ok; j++) {
+                        double s = A[j*d+j];
+                        for (int k=0; k<j; k++) s -= A[j*d+k]*A[j*d+k];
+                        if (!(s > 0)) { ok = false; break; }
+                        A[j*d+j] = sqrt(s);
+                        for (int i=j+1; i<d; i++) {
+                                double t = A[i*d+j];
+                                for (int k=0; k<j; k++) t -= A[i*d+k]*A[j*d+k];
+                                A[i*d+j] = t / A[j*d+j];
+                        }
+                }
+                if (! ok) {
+                        debug2("Gram matrix in Andersen singular with %d directions\n", d);
+                        continue;
+                }
+                for (int i=0; i<d; i++) {
+                        double t = 1;
+                        for (int k=0; k<i; k++) t -= A[i*d+k]*c[k];
+                        c[i] = t / A[i*d+i];
+                }
+                for (int i=d-1; i>=0; i--) {
+                        double t = c[i];
+                        for (int k=i+1; k<d; k++) t -= A[k*d+i]*c[k];
+                        c[i] = t / A[i*d+i];
+                }
+                double csum = 0;
+                for (int i=0; i<d; i++) csum += c[i];
+                if (!(fabs(csum) > 0)) continue;
+                for (int i=0; i<d; i++) c[i] /= csum;
+                return d;
+        }
+        c[0] = 1;
+        return 1;
 }
 
 int acAndersen::Init () {
@@ -33,6 +100,10 @@ int acAndersen::Init () {
 			error("no Directions parameter in %s\n",node.name());
 			return -1;
 		}
+		if (directions < 1) {
+			error("Directions in %s have to be positive\n",node.name());
+			return -1;
+		}
 		attr = node.attribute("Times");
 		if (attr) {
 			times = attr.as_int();
@@ -47,7 +118,9 @@ int acAndersen::Init () {
 		output("Size of vector in Andersen: %ld\n", n);
 		x = (real_t **) malloc(directions*sizeof(real_t*));
 		e = (real_t **) malloc(directions*sizeof(real_t*));
-		p = (double *)  malloc(directions*sizeof(double));
+		G = (double *)  malloc(directions*directions*sizeof(double));
+		double * dots = (double *) malloc(directions*sizeof(double));
+		double * c = (double *) malloc(directions*sizeof(double));
 		output("Allocating %ld b for Anderson\n",(size_t)2*n*directions * sizeof(real_t));
 		real_t * mem = (real_t *) malloc(2*n*directions * sizeof(real_t));
 		for (int i = 0; i<directions; i++) {
@@ -57,57 +130,35 @@ int acAndersen::Init () {
 	        real_t * nx = (real_t *) malloc(n * sizeof(real_t));
 
                 int d = 0;
+                int head = directions - 1;
 
                 for (int it = 0; it < times; it++) {
-                        rotate(x,directions);
-                        rotate(e,directions);
-                        rotate(p,directions);
-                        
-                        
-                        solver->lattice->saveToTab(x[0]);
+                        head = (head + 1) % directions; // overwrite the oldest pair
+                        solver->lattice->saveToTab(x[head]);
                         if (GenericAction::ExecuteInternal()) return -1;
-                        solver->lattice->saveToTab(e[0]);
-                        for (size_t i=0; i<n; i++) e[0][i] = e[0][i] - x[0][i];
-                        double sum = skal(e[0],e[0]);
+                        solver->lattice->saveToTab(e[head]);
+                        d++;
+                        if (d > directions) d = directions;
+                        GramRow(head, d, dots);
+                        double sum = dots[0];
                         output("Residual in Andersen: %lg\n",sum);
                         if (!isfinite(sum)) break;
                         if (sum < eps) break;
-                        p[0] = 1;
-                        
-                        d++;
-                        if (d > directions)
-                        	d = directions; // Continue
-//                                d = 1;		// Restart
 
-//                        for (int i=0; i < d; i++) {		//Option A
-//                        for (int i=d-1; i >= 0; i--) {	//Option B - obsolete
-                        { int i=0;				//Option B
-//                                for (int j=0; j < i; j++) {	//Option A
-                                  for (int j=i+1; j < d; j++) {	//Option B
-                                        double a = skal(e[i],e[j]);
-                                        debug2("R[%d,%d]: %lg\n",i,j,a);
-                                        for (size_t k=0; k<n; k++) e[i][k] -= a * e[j][k];
-                                        for (size_t k=0; k<n; k++) x[i][k] -= a * x[j][k];
-                                        p[i] -= a * p[j];
-                                }
-                                double a = sqrt(skal(e[i],e[i]));
-                                debug2("R[%d,%d]: %lg\n",i,i,a);
-                                for (size_t k=0; k<n; k++) e[i][k] /= a;
-                                for (size_t k=0; k<n; k++) x[i][k] /= a;
-                                p[i] /= a;
-                        }
-                        debug2("Andersen p:");
-                        for (int i=0; i < d; i++) {
-                                debug2(" %lg",p[i]);
+                        int m = Coefficients(head, d, c);
+                        debug2("Andersen c:");
+                        for (int i=0; i < m; i++) {
+                                debug2(" %lg",c[i]);
                         }
                         debug2("\n");
 
-                        double psum = 0;
-                        for (int i=0; i < d; i++) psum += p[i]*p[i];
+                        std::vector<real_t *> hist(m);
+                        for (int i=0; i < m; i++) hist[i] = x[(head - i + directions) % directions];
+                        #pragma omp parallel for schedule(static)
                         for (size_t k=0; k<n; k++) {
-                                double sum = 0;
-                                for (int i=0; i < d; i++) sum += x[i][k]*p[i]/psum;
-                                nx[k] = sum;
+                                double val = 0;
+                                for (int i=0; i < m; i++) val += c[i]*hist[i][k];
+                                nx[k] = val;
                         }
                         solver->lattice->loadFromTab(nx);
                         if (GenericAction::ExecuteInternal()) return -1;
@@ -115,7 +166,9 @@ int acAndersen::Init () {
                 free(mem);
 		free(x);
 		free(e);
-		free(p);
+		free(G);
+		free(dots);
+		free(c);
 		free(nx);
 		return 0;
 }
@@ -10,10 +10,11 @@
 class  acAndersen  : public  GenericAction  {
 	int directions;
 	size_t n;
-	real_t** x;
-	real_t** e;
-	double *p;
-	double skal(real_t * a, real_t * b);
+	real_t** x; ///< Ring buffer of the states
+	real_t** e; ///< Ring buffer of the residuals
+	double *G; ///< Gram matrix of the residuals (indexed by the slots of the ring buffer)
+	int GramRow(int head, int d, double * dots);
+	int Coefficients(int head, int d, double * c);
 
 	public:
 	static std::string xmlname;
@@ -0,0 +1,197 @@
+#include "acDistributedOptimize.h"
+std::string acDistributedOptimize::xmlname = "DistributedOptimize";
+#include "../HandlerFactory.h"
+#include <algorithm>
+
+int acDistributedOptimize::Distributed () { return 1; }
+
+double acDistributedOptimize::Sum (double val) {
+	double ret;
+	MPI_Allreduce(&val, &ret, 1, MPI_DOUBLE, MPI_SUM, MPMD.local);
+	return ret;
+}
+
+double acDistributedOptimize::Max (double val) {
+	double ret;
+	MPI_Allreduce(&val, &ret, 1, MPI_DOUBLE, MPI_MAX, MPMD.local);
+	return ret;
+}
+
+/// Solve the separable MMA subproblem for a given dual variable
+/**
+	Puts the minimizer of the approximated Lagrangian in xnew
+	and returns the value of the approximated constraint
+*/
+double acDistributedOptimize::Constraint (double lambda, double r) {
+	double sum = 0;
+	for (int i=0; i<LocalPars; i++) {
+		double P = sqrt(p0[i] + lambda*p1[i]);
+		double Q = sqrt(q0[i] + lambda*q1[i]);
+		double v = (P*low[i] + Q*upp[i])/(P + Q);
+		if (v < alpha[i]) v = alpha[i];
+		if (v > beta[i]) v = beta[i];
+		xnew[i] = v;
+		sum += p1[i]/(upp[i] - v) + q1[i]/(v - low[i]);
+	}
+	return r + Sum(sum);
+}
+
+int acDistributedOptimize::OptimizerInit () {
+	pugi::xml_attribute attr;
+	material = 0.0;
+	stop = false;
+	if (Sum(LocalPars) == 0) {
+		ERROR("Error: No parameters defined!\n");
+		return -1;
+	}
+	notice("Parameters in optimization: %.0lf\n", Sum(LocalPars));
+	x.resize(LocalPars); xold1.resize(LocalPars); xold2.resize(LocalPars);
+	low.resize(LocalPars); upp.resize(LocalPars); grad.resize(LocalPars);
+	lower.resize(LocalPars); upper.resize(LocalPars);
+	alpha.resize(LocalPars); beta.resize(LocalPars); xnew.resize(LocalPars);
+	p0.resize(LocalPars); q0.resize(LocalPars); p1.resize(LocalPars); q1.resize(LocalPars);
+	GetLocalParameters(x.data());
+	LocalParameters(PAR_LOWER, lower.data());
+	LocalParameters(PAR_UPPER, upper.data());
+	for (int i=0; i<LocalPars; i++) {
+		if (x[i] < lower[i]) x[i] = lower[i];
+		if (x[i] > upper[i]) x[i] = upper[i];
+	}
+	matdir = 0;
+	attr = node.attribute("Material");
+	if (attr) {
+		std::string dir(attr.value());
+		if (dir == "more") {
+			matdir = 1;
+		} else if (dir == "less") {
+			matdir = -1;
+		} else {
+			error("Material attribute in DistributedOptimize should be \"more\" or \"less\"\n");
+			return -1;
+		}
+		double sum = 0;
+		for (int i=0; i<LocalPars; i++) sum += x[i];
+		material = Sum(sum);
+	}
+	maxeval = node.attribute("MaxEvaluations").as_int(0);
+	xtol = node.attribute("XAbsTolerance").as_double(0);
+	ftol_rel = node.attribute("RelTolerance").as_double(0);
+	ftol_abs = node.attribute("AbsTolerance").as_double(0);
+	move = node.attribute("MoveLimit").as_double(0.5);
+	if ((maxeval < 0) || (xtol < 0) || (ftol_rel < 0) || (ftol_abs < 0)) {
+		error("Tolerances and MaxEvaluations in DistributedOptimize have to be positive\n");
+		return -1;
+	}
+	if ((move <= 0) || (move > 1)) {
+		error("MoveLimit in DistributedOptimize have to be in (0,1]\n");
+		return -1;
+	}
+	if ((maxeval == 0) && (xtol == 0) && (ftol_rel == 0) && (ftol_abs == 0)) {
+		error("No stopping criterion in DistributedOptimize (MaxEvaluations, XAbsTolerance, RelTolerance, AbsTolerance)\n");
+		return -1;
+	}
+	return 0;
+}
+
+/// Run the MMA iterations
+/**
+	Objective is maximized (as in Optimize), so MMA minimizes its negative.
+	Asymptotes and move limits follow Svanberg (1987, 2002).
+*/
+int acDistributedOptimize::OptimizerRun () {
+	double f = NAN, fold = NAN;
+	double dummy;
+	double * gradp = LocalPars > 0 ? grad.data() : &dummy; // NULL would mean no gradient needed
+	for (int it = 0; (maxeval == 0) || (it < maxeval); it++) {
+		if (ExecuteLocal(x.data(), gradp, &f)) {
+			ERROR("Error while executing calculations in DistributedOptimize. exiting loop.\n");
+			return -1;
+		}
+		if (stop) break;
+		if (it > 0) {
+			double df = fabs(f - fold);
+			if ((ftol_abs > 0) && (df <= ftol_abs)) { notice("Optimization stoped with change of objective below tolerance (AbsTolerance) !\n"); break; }
+			if ((ftol_rel > 0) && (df <= ftol_rel*fabs(f))) { notice("Optimization stoped with change of objective below tolerance (RelTolerance) !\n"); break; }
+		}
+		fold = f;
+
+		double g = 0;
+		if (matdir != 0) {
+			double sum = 0;
+			for (int i=0; i<LocalPars; i++) sum += x[i];
+			sum = Sum(sum);
+			output("Material %le (%le at start)\n", sum, material);
+			g = matdir * (sum - material);
+		}
+		double sum = 0;
+		for (int i=0; i<LocalPars; i++) {
+			double range = upper[i] - lower[i];
+			if (it < 2) {
+				low[i] = x[i] - 0.5*range;
+				upp[i] = x[i] + 0.5*range;
+			} else {
+				double z = (x[i] - xold1[i])*(xold1[i] - xold2[i]);
+				double gamma = 1.0;
+				if (z < 0) gamma = 0.7;
+				if (z > 0) gamma = 1.2;
+				low[i] = x[i] - gamma*(xold1[i] - low[i]);
+				upp[i] = x[i] + gamma*(upp[i] - xold1[i]);
+				low[i] = std::max(std::min(low[i], x[i] - 0.01*range), x[i] - 10*range);
+				upp[i] = std::min(std::max(upp[i], x[i] + 0.01*range), x[i] + 10*range);
+			}
+			alpha[i] = std::max(std::max(lower[i], 0.9*low[i] + 0.1*x[i]), x[i] - move*range);
+			beta[i]  = std::min(std::min(upper[i], 0.9*upp[i] + 0.1*x[i]), x[i] + move*range);
+			double d0 = -grad[i];
+			double reg = 1e-5/range;
+			double ux = (upp[i] - x[i])*(upp[i] - x[i]), xl = (x[i] - low[i])*(x[i] - low[i]);
+			p0[i] = ux*(1.001*std::max(d0,0.0) + 0.001*std::max(-d0,0.0) + reg);
+			q0[i] = xl*(0.001*std::max(d0,0.0) + 1.001*std::max(-d0,0.0) + reg);
+			if (matdir != 0) {
+				double d1 = matdir;
+				p1[i] = ux*(1.001*std::max(d1,0.0) + 0.001*std::max(-d1,0.0) + reg);
+				q1[i] = xl*(0.001*std::max(d1,0.0) + 1.001*std::max(-d1,0.0) + reg);
+				sum += p1[i]/(upp[i] - x[i]) + q1[i]/(x[i] - low[i]);
+			} else {
+				p1[i] = 0;
+				q1[i] = 0;
+			}
+		}
+		double r = g - Sum(sum);
+
+		// Dual search: the approximated constraint decreases with lambda
+		double lambda = 0;
+		if (Constraint(0, r) > 0) {
+			double lo = 0, hi = 1;
+			while ((Constraint(hi, r) > 0) && (hi < 1e20)) { lo = hi; hi *= 10; }
+			for (int k=0; k<100 && (hi - lo) > 1e-12*hi; k++) {
+				lambda = (lo + hi)/2;
+				if (Constraint(lambda, r) > 0) lo = lambda; else hi = lambda;
+			}
+			lambda = hi;
+			Constraint(lambda, r);
+		}
+		debug1("MMA dual variable: %lg\n", lambda);
+
+		double change = 0;
+		for (int i=0; i<LocalPars; i++) change = std::max(change, fabs(xnew[i] - x[i]));
+		change = Max(change);
+		output("Maximal change of parameters: %lg\n", change);
+		if ((xtol > 0) && (change <= xtol)) {
+			notice("Optimization stoped with change of parameters below tolerance (XAbsTolerance) !\n");
+			break;
+		}
+		xold2 = xold1;
+		xold1 = x;
+		x = xnew;
+	}
+	notice("Final Objective value: %lf\n", f);
+	return 0;
+}
+
+int acDistributedOptimize::OptimizerExit () {
+	stop = true;
+	return 0;
+}
+
+// Register the handler (basing on xmlname) in the Handler Factory
+template class HandlerFactory::Register< GenericAsk< acDistributedOptimize > >;
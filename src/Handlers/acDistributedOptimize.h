@@ -0,0 +1,36 @@
+#ifndef ACDISTRIBUTEDOPTIMIZE_H
+#define ACDISTRIBUTEDOPTIMIZE_H
+
+#include "../CommonHandler.h"
+
+#include "vHandler.h"
+#include "Action.h"
+#include "GenericAction.h"
+#include "GenericOptimizer.h"
+#include <vector>
+
+/// Method of Moving Asymptotes with the parameter vector partitioned between processors
+/**
+	Each processor keeps only its part of the parameters (see NumberOfLocalParameters).
+	The MMA subproblem is separable, so only the objective, the material
+	constraint and the dual variable search need global sums.
+*/
+class  acDistributedOptimize  : public  GenericOptimizer  {
+	std::vector<double> x, xold1, xold2, low, upp, lower, upper, grad;
+	std::vector<double> alpha, beta, p0, q0, p1, q1, xnew;
+	int maxeval;
+	double xtol, ftol_rel, ftol_abs, move;
+	int matdir;
+	bool stop;
+	double Sum(double val);
+	double Max(double val);
+	double Constraint(double lambda, double r);
+	public:
+	static std::string xmlname;
+int Distributed ();
+int OptimizerInit ();
+int OptimizerRun ();
+int OptimizerExit ();
+};
+
+#endif // ACDISTRIBUTEDOPTIMIZE_H
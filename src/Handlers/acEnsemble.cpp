@@ -0,0 +1,170 @@
+#include "acEnsemble.h"
+std::string acEnsemble::xmlname = "Ensemble";
+#include "../HandlerFactory.h"
+
+void acEnsemble::Enter(Member& m) {
+		solver->lattice = m.lattice;
+		strcpy(solver->info.outpath, m.outpath.c_str());
+		solver->hands.swap(m.hands);
+	}
+
+
+void acEnsemble::Leave(Member& m) {
+		solver->hands.swap(m.hands);
+		solver->lattice = main_lattice;
+		strcpy(solver->info.outpath, main_outpath.c_str());
+	}
+
+
+int acEnsemble::SetupMember(Member& m, pugi::xml_node member_node) {
+		Lattice * lattice = m.lattice;
+		lattice->Callback(main_lattice->callback, main_lattice->callback_data);
+		lattice->setPosition(main_lattice->px, main_lattice->py, main_lattice->pz);
+		lattice->FlagOverwrite(solver->geometry->geom, solver->geometry->region);
+		lattice->CutsOverwrite(solver->geometry->Qidx, solver->geometry->Q.data(), solver->geometry->region);
+		lattice->zSet.copy(main_lattice->zSet);
+		for (int i=0; i<SETTINGS; i++) lattice->setSetting(i, main_lattice->settings[i]);
+		sprintf(lattice->snapFileName, "%s_Snap", m.outpath.c_str());
+		for (pugi::xml_node par = member_node.first_child(); par; par = par.next_sibling()) {
+			Handler hand(par, solver);
+			if (! hand) {
+				ERROR("Something wrong in %s\n", member_node.name());
+				return -1;
+			}
+			if (hand.Type() & HANDLER_CALLBACK) {
+				if (hand.hand->everyIter != 0) {
+					ERROR("%s in %s cannot be called every some iterations\n", par.name(), member_node.name());
+					return -1;
+				}
+				if (hand.DoIt()) {
+					error("Handler call error: %s", par.name());
+					return -1;
+				}
+			}
+		}
+		lattice->Init();
+		return 0;
+	}
+
+
+int acEnsemble::Init () {
+		GenericAction::Init();
+		main_lattice = solver->lattice;
+		main_outpath = solver->info.outpath;
+		int start_iter = solver->iter;
+		for (pugi::xml_node par = node.child("Member"); par; par = par.next_sibling("Member")) {
+			char buf[STRING_LEN];
+			sprintf(buf, "%s_M%02ld", main_outpath.c_str(), members.size());
+			Member m;
+			m.lattice = NULL;
+			m.outpath = buf;
+			m.active = true;
+			members.push_back(m);
+		}
+		if (members.size() < 1) {
+			ERROR("No Member elements in %s\n", node.name());
+			return -1;
+		}
+		output("Running an ensemble of %ld members\n", members.size());
+
+		int ret = 0;
+		for (size_t k=0; k<members.size(); k++) {
+			members[k].lattice = new Lattice(solver->region, solver->mpi, 2);
+		}
+		{
+			size_t k = 0;
+			for (pugi::xml_node par = node.child("Member"); par; par = par.next_sibling("Member"), k++) {
+				Enter(members[k]);
+				notice("Setting up ensemble member %ld (%s)\n", k, members[k].outpath.c_str());
+				ret = SetupMember(members[k], par);
+				if (ret == 0) {
+					for (pugi::xml_node ch = node.first_child(); ch; ch = ch.next_sibling()) if (strcmp(ch.name(), "Member") != 0) {
+						Handler hand(ch, solver);
+						if (! hand) {
+							ERROR("Something wrong in %s\n", node.name());
+							ret = -1;
+							break;
+						}
+						if (hand.Type() & HANDLER_DESIGN) {
+							ERROR("Design elements (%s) are not allowed in %s\n", ch.name(), node.name());
+							ret = -1;
+							break;
+						}
+						if (hand.Type() & HANDLER_CALLBACK) {
+							if (hand.hand->everyIter != 0) {
+								solver->hands.push_back(hand);
+							} else if (hand.DoIt()) {
+								error("Handler call error: %s", ch.name());
+								ret = -1;
+								break;
+							}
+						}
+					}
+				}
+				Leave(members[k]);
+				if (ret) break;
+			}
+		}
+
+		// All members go through a segment before any handler is called,
+		//  so that the member lattices are iterated back to back.
+		while (ret == 0) {
+			int my_next_it = Next(solver->iter);
+			int next_it = my_next_it;
+			int n_active = 0;
+			for (size_t k=0; k<members.size(); k++) if (members[k].active) {
+				n_active++;
+				for (size_t i=0; i<members[k].hands.size(); i++) {
+					int it = members[k].hands[i].Next(solver->iter);
+					if ((it > 0) && (it < next_it)) next_it = it;
+				}
+			}
+			if (n_active == 0) break;
+			solver->steps = next_it;
+			MPI_Bcast(&solver->steps, 1, MPI_INT, 0, MPMD.local);
+			int iter_type = solver->iter_type;
+			if (solver->steps == my_next_it) iter_type |= ITER_LASTGLOB;
+			for (size_t k=0; k<members.size(); k++) if (members[k].active) {
+				Enter(members[k]);
+				solver->lattice->Iterate(solver->steps, iter_type);
+				Leave(members[k]);
+			}
+			CudaDeviceSynchronize();
+			MPI_Barrier(MPMD.local);
+			solver->iter += solver->steps;
+			for (size_t k=0; k<members.size(); k++) if (members[k].active) {
+				Enter(members[k]);
+				for (size_t i=0; i<solver->hands.size(); i++) {
+					if (solver->hands[i].Now(solver->iter)) {
+						int hret = solver->hands[i].DoIt();
+						if (hret == ITERATION_STOP) {
+							notice("Ensemble member %ld stopped at %d iterations\n", k, solver->iter);
+							members[k].active = false;
+						} else if (hret != 0) {
+							ret = -1;
+						}
+					}
+				}
+				Leave(members[k]);
+			}
+			if (Now(solver->iter)) break;
+		}
+		CudaDeviceSynchronize();
+		MPI_Barrier(MPMD.local);
+
+		for (size_t k=0; k<members.size(); k++) {
+			if (members[k].lattice != NULL) {
+				Enter(members[k]);
+				solver->hands.clear();
+				Leave(members[k]);
+				delete members[k].lattice;
+			}
+		}
+		members.clear();
+		solver->iter = start_iter;
+		return ret;
+	}
+
+
+// Register the handler (basing on xmlname) in the Handler Factory
+template class HandlerFactory::Register< GenericAsk< acEnsemble > >;
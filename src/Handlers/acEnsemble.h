@@ -0,0 +1,38 @@
+#ifndef ACENSEMBLE_H
+#define ACENSEMBLE_H
+
+#include "../CommonHandler.h"
+
+#include "vHandler.h"
+#include "Action.h"
+#include "GenericAction.h"
+#include <vector>
+#include <string>
+
+/// Runs many independent copies of the case in one process
+/**
+	Every <Member> child gets its own Lattice (with geometry and settings
+	copied from the main one, and then changed by the Member's elements).
+	The remaining children are created separately for every member, so
+	each member writes its own Logs and outputs (with _M00, _M01 ... prefix).
+	The members are iterated in turn, segment by segment.
+*/
+class  acEnsemble  : public  GenericAction  {
+	struct Member {
+		Lattice * lattice; ///< Lattice of the member
+		std::string outpath; ///< Output prefix of the member
+		std::vector<Handler> hands; ///< Handlers stacked for the member
+		bool active; ///< False if one of the handlers stopped the member
+	};
+	std::vector<Member> members;
+	Lattice * main_lattice;
+	std::string main_outpath;
+	void Enter(Member& m);
+	void Leave(Member& m);
+	int SetupMember(Member& m, pugi::xml_node member_node);
+	public:
+	static std::string xmlname;
+int Init ();
+};
+
+#endif // ACENSEMBLE_H
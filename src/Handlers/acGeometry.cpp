@@ -18,7 +18,7 @@ int acGeometry::Init () {
 				return -1;
 			}
 			solver->lattice->FlagOverwrite(solver->geometry->geom,solver->geometry->region);
-			solver->lattice->CutsOverwrite(solver->geometry->Q,solver->geometry->region);
+			solver->lattice->CutsOverwrite(solver->geometry->Qidx,solver->geometry->Q.data(),solver->geometry->region);
 			solver->lattice->zSet.zone_max(solver->geometry->SettingZones.size()-1);
 			return 0;
 	}
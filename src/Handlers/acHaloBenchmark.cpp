@@ -0,0 +1,26 @@
+#include "acHaloBenchmark.h"
+
+std::string acHaloBenchmark::xmlname = "HaloBenchmark";
+
+int acHaloBenchmark::Init () {
+		int times = 100;
+		pugi::xml_attribute attr = node.attribute("Times");
+		if (attr) times = attr.as_int();
+		if (times < 1) {
+			error("Minimal number for Times attribute is 1\n");
+			return -1;
+		}
+		size_t bytes = 0;
+		solver->lattice->HaloBenchmark(1, NULL); // warm-up (creates the persistent requests)
+		double t = solver->lattice->HaloBenchmark(times, &bytes);
+		unsigned long long int b = bytes, maxb;
+		MPI_Reduce(&b, &maxb, 1, MPI_UNSIGNED_LONG_LONG, MPI_MAX, 0, MPMD.local);
+		if (solver->mpi_rank == 0) {
+			notice("Halo exchange: %.2lf us per exchange, up to %llu B per processor (%.1lf MB/s)\n", t*1e6, maxb, maxb/t/1e6);
+		}
+		return 0;
+	}
+
+
+// Register the handler (basing on xmlname) in the Handler Factory
+template class HandlerFactory::Register< GenericAsk< acHaloBenchmark > >;
@@ -0,0 +1,15 @@
+#ifndef ACHALOBENCHMARK_H
+#define ACHALOBENCHMARK_H
+
+#include "../CommonHandler.h"
+
+#include "vHandler.h"
+#include "Action.h"
+
+class  acHaloBenchmark  : public  Action  {
+	public:
+	static std::string xmlname;
+int Init ();
+};
+
+#endif // ACHALOBENCHMARK_H
@@ -0,0 +1,167 @@
+#include "acLoadCoarse.h"
+std::string acLoadCoarse::xmlname = "LoadCoarse";
+#include "../HandlerFactory.h"
+#include <algorithm>
+
+/// Position of a node of the fine lattice in the coarse one (cell centered)
+static inline double coarse_position(int x, int n, int nc) {
+	return (x + 0.5) * nc / n - 0.5;
+}
+
+/// Lower node and weight of the linear interpolation (clamped at the edges)
+static inline void coarse_stencil(double xc, int nc, int & i0, int & i1, double & w) {
+	int i = (int) floor(xc);
+	w = xc - i;
+	i0 = i;
+	i1 = i + 1;
+	if (i0 < 0) i0 = 0;
+	if (i1 < 0) i1 = 0;
+	if (i0 > nc-1) i0 = nc-1;
+	if (i1 > nc-1) i1 = nc-1;
+}
+
+int acLoadCoarse::Init () {
+		Action::Init();
+		pugi::xml_attribute attr = node.attribute("file");
+		if (!attr) {
+			error("No file specified in LoadCoarse\n");
+			return -1;
+		}
+		std::string prefix = attr.value();
+		lbRegion reg = solver->region;
+		lbRegion tot = solver->info.region;
+		// Headers of all the files (see SaveFields): from the index, or from the files themselves
+		std::vector<int> heads;
+		{
+			char fname[STRING_LEN];
+			sprintf(fname, "%s.index", prefix.c_str());
+			FILE * f = fopen(fname, "rb");
+			if (f != NULL) {
+				int parts = 0;
+				if ((fread(&parts, sizeof(int), 1, f) != 1) || (parts < 1)) {
+					ERROR("Wrong index %s\n", fname);
+					fclose(f);
+					return -1;
+				}
+				heads.resize(10 * parts);
+				if (fread(heads.data(), sizeof(int), heads.size(), f) != heads.size()) {
+					ERROR("%s is too short\n", fname);
+					fclose(f);
+					return -1;
+				}
+				fclose(f);
+			} else {
+				warning("No %s: reading the headers of all the %s_*.fields files\n", fname, prefix.c_str());
+				for (int p=0; ; p++) {
+					sprintf(fname, "%s_%d.fields", prefix.c_str(), p);
+					f = fopen(fname, "rb");
+					if (f == NULL) break;
+					int head[10];
+					if (fread(head, sizeof(int), 10, f) != 10) {
+						ERROR("Wrong header in %s\n", fname);
+						fclose(f);
+						return -1;
+					}
+					fclose(f);
+					heads.insert(heads.end(), head, head + 10);
+				}
+			}
+		}
+		int parts = heads.size() / 10;
+		if (parts == 0) {
+			ERROR("No %s_*.fields files found\n", prefix.c_str());
+			return -1;
+		}
+		int nc[3];
+		for (int k=0; k<3; k++) nc[k] = heads[1+k];
+		output("Interpolating fields from a %dx%dx%d lattice (%s)\n", nc[0], nc[1], nc[2], prefix.c_str());
+		// Window of the coarse lattice needed by the local region
+		lbRegion win;
+		{
+			int lo[3], hi[3], a, b;
+			double w;
+			int d0[3] = {reg.dx, reg.dy, reg.dz};
+			int n0[3] = {reg.nx, reg.ny, reg.nz};
+			int nt[3] = {tot.nx, tot.ny, tot.nz};
+			for (int k=0; k<3; k++) {
+				coarse_stencil(coarse_position(d0[k], nt[k], nc[k]), nc[k], lo[k], b, w);
+				coarse_stencil(coarse_position(d0[k]+n0[k]-1, nt[k], nc[k]), nc[k], a, hi[k], w);
+			}
+			win = lbRegion(lo[0], lo[1], lo[2], hi[0]-lo[0]+1, hi[1]-lo[1]+1, hi[2]-lo[2]+1);
+		}
+		std::vector<double> data(FIELDS * win.sizeL());
+		int files = 0;
+		for (int p=0; p<parts; p++) {
+			const int * head = &heads[10*p];
+			if (head[0] != FIELDS) {
+				ERROR("%s_%d.fields has %d fields (model has %d)\n", prefix.c_str(), p, head[0], FIELDS);
+				return -1;
+			}
+			if ((head[1] != nc[0]) || (head[2] != nc[1]) || (head[3] != nc[2])) {
+				ERROR("%s_%d.fields is from a different lattice (%dx%dx%d)\n", prefix.c_str(), p, head[1], head[2], head[3]);
+				return -1;
+			}
+			lbRegion part(head[4], head[5], head[6], head[7], head[8], head[9]);
+			lbRegion inter = win.intersect(part);
+			if (inter.size() == 0) continue;
+			char fname[STRING_LEN];
+			sprintf(fname, "%s_%d.fields", prefix.c_str(), p);
+			FILE * f = fopen(fname, "rb");
+			if (f == NULL) {
+				ERROR("Cannot open %s\n", fname);
+				return -1;
+			}
+			int fhead[10];
+			if ((fread(fhead, sizeof(int), 10, f) != 10) || (! std::equal(fhead, fhead + 10, head))) {
+				ERROR("Header of %s does not match the index\n", fname);
+				fclose(f);
+				return -1;
+			}
+			std::vector<double> buf(part.sizeL());
+			for (int k=0; k<FIELDS; k++) {
+				if (fread(&buf[0], sizeof(double), buf.size(), f) != buf.size()) {
+					ERROR("%s is too short\n", fname);
+					fclose(f);
+					return -1;
+				}
+				for (int z=inter.dz; z<inter.dz+inter.nz; z++)
+				for (int y=inter.dy; y<inter.dy+inter.ny; y++)
+				for (int x=inter.dx; x<inter.dx+inter.nx; x++)
+					data[k*win.sizeL() + win.offsetL(x,y,z)] = buf[part.offsetL(x,y,z)];
+			}
+			fclose(f);
+			files++;
+		}
+		debug1("Read %d of %d field files\n", files, parts);
+
+		size_t n = reg.sizeL();
+		real_t * tab = new real_t[FIELDS * n];
+		#pragma omp parallel for
+		for (int z=reg.dz; z<reg.dz+reg.nz; z++) {
+			int x0, x1, y0, y1, z0, z1;
+			double wx, wy, wz;
+			coarse_stencil(coarse_position(z, tot.nz, nc[2]), nc[2], z0, z1, wz);
+			for (int y=reg.dy; y<reg.dy+reg.ny; y++) {
+				coarse_stencil(coarse_position(y, tot.ny, nc[1]), nc[1], y0, y1, wy);
+				for (int x=reg.dx; x<reg.dx+reg.nx; x++) {
+					coarse_stencil(coarse_position(x, tot.nx, nc[0]), nc[0], x0, x1, wx);
+					for (int k=0; k<FIELDS; k++) {
+						const double * d = &data[k*win.sizeL()];
+						double v =
+							(1-wz)*((1-wy)*((1-wx)*d[win.offsetL(x0,y0,z0)] + wx*d[win.offsetL(x1,y0,z0)])
+							       +   wy *((1-wx)*d[win.offsetL(x0,y1,z0)] + wx*d[win.offsetL(x1,y1,z0)]))
+							+ wz *((1-wy)*((1-wx)*d[win.offsetL(x0,y0,z1)] + wx*d[win.offsetL(x1,y0,z1)])
+							       +   wy *((1-wx)*d[win.offsetL(x0,y1,z1)] + wx*d[win.offsetL(x1,y1,z1)]));
+						tab[k*n + reg.offsetL(x,y,z)] = v;
+					}
+				}
+			}
+		}
+		solver->lattice->SetFields(tab);
+		delete[] tab;
+		return 0;
+	}
+
+
+// Register the handler (basing on xmlname) in the Handler Factory
+template class HandlerFactory::Register< GenericAsk< acLoadCoarse > >;
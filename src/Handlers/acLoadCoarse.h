@@ -0,0 +1,21 @@
+#ifndef ACLOADCOARSE_H
+#define ACLOADCOARSE_H
+
+#include "../CommonHandler.h"
+
+#include "vHandler.h"
+#include "Action.h"
+
+/// Initializes the lattice from a (coarser) solution saved by SaveFields
+/**
+	The Fields are interpolated (trilinearly, in the global coordinates
+	scaled to the size of the mesh) from the saved lattice, which can have
+	a different size and a different decomposition.
+*/
+class  acLoadCoarse  : public  Action  {
+	public:
+	static std::string xmlname;
+int Init ();
+};
+
+#endif // ACLOADCOARSE_H
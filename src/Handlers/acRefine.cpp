@@ -0,0 +1,67 @@
+#include "acRefine.h"
+std::string acRefine::xmlname = "Refine";
+#include "../HandlerFactory.h"
+#include "../Refinement.h"
+
+int acRefine::AddPatches(pugi::xml_node parent_node, Lattice * lat, int level) {
+		lbRegion total = lat->mpi.totalregion;
+		std::vector<lbRegion> boxes;
+		for (pugi::xml_node par = parent_node.child("Patch"); par; par = par.next_sibling("Patch")) {
+			int d[3] = { 0, 0, 0 }, n[3], tn[3] = { total.nx, total.ny, total.nz };
+			const char * dn[3] = { "dx", "dy", "dz" }, * nn[3] = { "nx", "ny", "nz" };
+			for (int k=0; k<3; k++) {
+				pugi::xml_attribute attr = par.attribute(dn[k]);
+				if (attr) d[k] = myround(solver->units.alt(attr.value()));
+				if (d[k] < 0) d[k] += tn[k];
+				n[k] = tn[k] - d[k];
+				attr = par.attribute(nn[k]);
+				if (attr) n[k] = myround(solver->units.alt(attr.value()));
+			}
+			lbRegion box(d[0], d[1], d[2], n[0], n[1], n[2]);
+			for (size_t i=0; i<boxes.size(); i++) if (boxes[i].intersect(box).size() > 0) {
+				error("Refinement patches of the same level cannot overlap\n");
+				return -1;
+			}
+			boxes.push_back(box);
+			notice("Refinement patch (level %d): %dx%dx%d at %d,%d,%d\n", level, box.nx, box.ny, box.nz, box.dx, box.dy, box.dz);
+			RefinePatch * patch = new RefinePatch(lat, box, ring);
+			if (patch->Init(solver->units, solver->info.xsdim, nu, group)) {
+				delete patch;
+				return -1;
+			}
+			lat->patches.push_back(patch);
+			int ret = AddPatches(par, patch->lattice, level + 1);
+			if (ret) return ret;
+		}
+		return 0;
+	}
+
+
+int acRefine::Init () {
+		ring = 2;
+		nu = "nu";
+		group = "f";
+		pugi::xml_attribute attr = node.attribute("ring");
+		if (attr) ring = attr.as_int();
+		if (ring < 1) {
+			error("ring in Refine has to be at least 1\n");
+			return -1;
+		}
+		attr = node.attribute("nu");
+		if (attr) nu = attr.value();
+		attr = node.attribute("group");
+		if (attr) group = attr.value();
+		if (solver->lattice->patches.size() > 0) {
+			error("Refinement patches are already set\n");
+			return -1;
+		}
+		if (! node.child("Patch")) {
+			error("No Patch elements in Refine\n");
+			return -1;
+		}
+		return AddPatches(node, solver->lattice, 1);
+	}
+
+
+// Register the handler (basing on xmlname) in the Handler Factory
+template class HandlerFactory::Register< GenericAsk< acRefine > >;
@@ -0,0 +1,25 @@
+#ifndef ACREFINE_H
+#define ACREFINE_H
+
+#include "../CommonHandler.h"
+
+#include "vHandler.h"
+#include "Action.h"
+#include <string>
+
+/// Adds block-structured refinement patches to the Lattice
+/**
+	Every <Patch> child is a box of the lattice covered by a Lattice with
+	twice the resolution (see RefinePatch), sub-cycled with the main one.
+	<Patch> elements inside of a <Patch> refine its fine Lattice further.
+*/
+class  acRefine  : public  Action  {
+	int ring;
+	std::string nu, group;
+	int AddPatches(pugi::xml_node parent_node, Lattice * lat, int level);
+	public:
+	static std::string xmlname;
+int Init ();
+};
+
+#endif // ACREFINE_H
@@ -1,6 +1,7 @@
 #include "acRemoteForceInterface.h"
 std::string acRemoteForceInterface::xmlname = "RemoteForceInterface";
 #include "../HandlerFactory.h"
+#include "../SimplePart.hpp"
 
 #include <sstream>
 
@@ -48,6 +49,7 @@ int acRemoteForceInterface::ConnectRemoteForceInterface(std::string integrator_)
         stats_prefix = stats_prefix + "_RFI";
         int stats_iter = 200;
         bool use_box = true;
+        std::string transport = "mpi";
 
 
         for (pugi::xml_attribute attr = node.first_attribute(); attr; attr = attr.next_attribute()) {
@@ -62,6 +64,8 @@ int acRemoteForceInterface::ConnectRemoteForceInterface(std::string integrator_)
           } else if (attr_name == "stats_prefix") {
             stats_prefix = attr.value();
             stats = true;
+          } else if (attr_name == "transport") {
+            transport = attr.value();
           } else if (attr_name == "use_box") {
             use_box = attr.as_bool();
           } else if (attr_name == "omega") {
@@ -81,10 +85,21 @@ int acRemoteForceInterface::ConnectRemoteForceInterface(std::string integrator_)
           solver->lattice->RFI.enableStats(stats_prefix.c_str(), stats_iter);
         }
 
-        inter = MPMD[integrator_];
-        if (! inter) {
-                ERROR("Integrator %s not found in MPMD (that usualy means that you didn't run it)\n",integrator_.c_str());
-                return -1;
+        if (transport == "local") {
+          if (integrator_ != "SIMPLEPART") {
+            ERROR("Only the SIMPLEPART integrator can run in-process (transport=\"local\")\n");
+            return -1;
+          }
+          if (stats) WARNING("RFI stats are not collected for the in-process transport\n");
+        } else if (transport == "mpi") {
+          inter = MPMD[integrator_];
+          if (! inter) {
+                  ERROR("Integrator %s not found in MPMD (that usualy means that you didn't run it)\n",integrator_.c_str());
+                  return -1;
+          }
+        } else {
+          ERROR("Unknown RFI transport '%s' (should be mpi or local)\n", transport.c_str());
+          return -1;
         }
         integrator = integrator_;
 
@@ -102,6 +117,17 @@ int acRemoteForceInterface::ConnectRemoteForceInterface(std::string integrator_)
             pz + reg.dz + reg.nz + PART_MAR_BOX);
         }
 
+        if (transport == "local") {
+          simplepart::LocalSimplePart< rfi_t >* local = new simplepart::LocalSimplePart< rfi_t >();
+          local->RFI.name = "SIMPLEPART";
+          if (solver->lattice->RFI.ConnectLocal(MPMD.local, local->RFI, local)) {
+            delete local;
+            return -1;
+          }
+          solver->lattice->RFI_local = local;
+          return local->SP.Init(local->RFI, NULL, MPMD.local, true);
+        }
+
         MPI_Barrier(MPMD.local);
         solver->lattice->RFI.Connect(MPMD.work,inter.work);
         
@@ -43,6 +43,8 @@ int acSyntheticTurbulence::Init () {
 		        nmodes = 100;
 		}
 		solver->lattice->ST.resize(nmodes);
+		attr = node.attribute("Seed");
+		if (attr) solver->lattice->ST.setSeed(attr.as_ullong());
 
 		std::string spread;
 		attr = node.attribute("Spread");
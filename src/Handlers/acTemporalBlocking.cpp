@@ -0,0 +1,49 @@
+#include "acTemporalBlocking.h"
+
+std::string acTemporalBlocking::xmlname = "TemporalBlocking";
+
+int acTemporalBlocking::Init () {
+		int steps = 4;
+		pugi::xml_attribute attr = node.attribute("Steps");
+		if (attr) steps = attr.as_int();
+		if (steps < 0) {
+			error("Steps in TemporalBlocking cannot be negative\n");
+			return -1;
+		}
+		solver->lattice->temporal_steps = steps;
+		int possible = solver->lattice->TemporalSteps(steps, ITER_NORM) > 1, all;
+		MPI_Allreduce(&possible, &all, 1, MPI_INT, MPI_MIN, MPMD.local);
+		if ((steps > 1) && (! all)) {
+			if (solver->lattice->bufnumber > 0) {
+				notice("Temporal blocking will not be used: the lattice is divided between processors and the halo is only one iteration deep\n");
+			} else {
+				notice("Temporal blocking will not be used (needs CPU, single stage Iteration, no samples and no halo exchange)\n");
+			}
+		}
+		attr = node.attribute("Benchmark");
+		if (attr) {
+			int n = attr.as_int();
+			if (n < 1) {
+				error("Minimal number for Benchmark attribute is 1\n");
+				return -1;
+			}
+			double times[2];
+			double diff = solver->lattice->TemporalBenchmark(n, times);
+			solver->iter += n;
+			if (solver->mpi_rank == 0) {
+				double mlups = solver->region.size() / 1e6;
+				notice("Standard iterations: %.3lf ms (%.1lf MLUPS)\n", times[0]*1e3, mlups/times[0]);
+				notice("Temporal blocking (%d steps): %.3lf ms (%.1lf MLUPS)\n", steps, times[1]*1e3, mlups/times[1]);
+				if (diff > 0) {
+					warning("Temporal blocking gave different results in %.0lf values\n", diff);
+				} else {
+					notice("Results of temporal blocking are identical\n");
+				}
+			}
+		}
+		return 0;
+	}
+
+
+// Register the handler (basing on xmlname) in the Handler Factory
+template class HandlerFactory::Register< GenericAsk< acTemporalBlocking > >;
@@ -0,0 +1,15 @@
+#ifndef ACTEMPORALBLOCKING_H
+#define ACTEMPORALBLOCKING_H
+
+#include "../CommonHandler.h"
+
+#include "vHandler.h"
+#include "Action.h"
+
+class  acTemporalBlocking  : public  Action  {
+	public:
+	static std::string xmlname;
+int Init ();
+};
+
+#endif // ACTEMPORALBLOCKING_H
@@ -0,0 +1,316 @@
+#include "cbExtract.h"
+std::string cbExtract::xmlname = "Extract";
+#include "../HandlerFactory.h"
+
+/// Region extended by one node in the positive directions
+static lbRegion extendUp(lbRegion reg) {
+	reg.nx++;
+	reg.ny++;
+	reg.nz++;
+	return reg;
+}
+
+/// Polygonize one simplex (tetrahedron or triangle)
+/**
+	Vertices with value below iso are inside. A tetrahedron gives one or
+	two triangles, and a triangle gives one segment. The vertices of the
+	resulting elements are appended to out (3 coordinates each).
+*/
+static void simplexIso(int n, const double (*p)[3], const double* v, double iso, std::vector<double>& out) {
+	int in[4], ex[4];
+	int nin = 0, nex = 0;
+	for (int i=0; i<n; i++) {
+		if (v[i] < iso) in[nin++] = i; else ex[nex++] = i;
+	}
+	if (nin == 0 || nex == 0) return;
+	auto edge = [&](int a, int b) {
+		double t = (iso - v[a]) / (v[b] - v[a]);
+		for (int j=0; j<3; j++) out.push_back(p[a][j] + t * (p[b][j] - p[a][j]));
+	};
+	if (nin == 1 || nex == 1) {
+		int lone = nin == 1 ? in[0] : ex[0];
+		for (int i=0; i<n; i++) if (i != lone) edge(lone, i);
+	} else {
+		// Two vertices inside and two outside of a tetrahedron: a quad split into two triangles
+		edge(in[0], ex[0]); edge(in[0], ex[1]); edge(in[1], ex[1]);
+		edge(in[0], ex[0]); edge(in[1], ex[1]); edge(in[1], ex[0]);
+	}
+}
+
+int cbExtract::Init () {
+		Callback::Init();
+		std::string nm = "Extract";
+		pugi::xml_attribute attr = node.attribute("name");
+		if (attr) nm = attr.value();
+		std::string what = "all";
+		attr = node.attribute("what");
+		if (attr) what = attr.value();
+		lbRegion total = solver->mpi.totalregion;
+		for (pugi::xml_node par = node.first_child(); par; par = par.next_sibling()) {
+			Extract e;
+			std::string type = par.name();
+			if (type == "Slice") {
+				e.type = EXTRACT_SLICE;
+			} else if (type == "Line") {
+				e.type = EXTRACT_LINE;
+			} else if (type == "Isosurface") {
+				e.type = EXTRACT_ISOSURFACE;
+			} else {
+				ERROR("Unknown element %s in %s\n", par.name(), node.name());
+				return -1;
+			}
+			char buf[STRING_LEN];
+			sprintf(buf, "%s_%s%ld", nm.c_str(), type.c_str(), extracts.size());
+			e.name = buf;
+			attr = par.attribute("name");
+			if (attr) e.name = nm + "_" + attr.value();
+			attr = par.attribute("what");
+			e.s.add_from_string(attr ? attr.value() : what, ',');
+			if (e.type == EXTRACT_ISOSURFACE) {
+				if (! attr) {
+					ERROR("Isosurface needs the Quantity ('what' attribute)\n");
+					return -1;
+				}
+				const Model::Quantity& q = solver->lattice->model->quantities.by_name(attr.value());
+				if (! q) {
+					ERROR("Unknown Quantity %s in Isosurface\n", attr.value());
+					return -1;
+				}
+				e.quantity = q.id;
+				attr = par.attribute("value");
+				if (! attr) {
+					ERROR("Isosurface needs the 'value' attribute\n");
+					return -1;
+				}
+				e.value = solver->units.alt(attr.value());
+			} else {
+				// Nodes with the given coordinates, along the axes not given
+				e.reg = total;
+				int given = 0;
+				attr = par.attribute("dx");
+				if (attr) { e.reg.dx = myround(solver->units.alt(attr.value())); e.reg.nx = 1; given++; }
+				attr = par.attribute("dy");
+				if (attr) { e.reg.dy = myround(solver->units.alt(attr.value())); e.reg.ny = 1; given++; }
+				attr = par.attribute("dz");
+				if (attr) { e.reg.dz = myround(solver->units.alt(attr.value())); e.reg.nz = 1; given++; }
+				int needed = e.type == EXTRACT_SLICE ? 1 : 2;
+				if (given != needed) {
+					ERROR("%s needs %d of the dx, dy, dz attributes\n", par.name(), needed);
+					return -1;
+				}
+				e.reg = e.reg.intersect(total);
+				if (e.reg.size() == 0) {
+					ERROR("%s %s is outside of the lattice\n", par.name(), e.name.c_str());
+					return -1;
+				}
+			}
+			extracts.push_back(e);
+		}
+		if (extracts.size() == 0) {
+			ERROR("No Slice, Line or Isosurface in %s\n", node.name());
+			return -1;
+		}
+		return 0;
+	}
+
+
+int cbExtract::WriteLine(Extract& e) {
+		Lattice * lattice = solver->lattice;
+		lbRegion inter = lattice->region.intersect(e.reg);
+		size_t n = e.reg.size();
+		int comps = 0;
+		for (const Model::Quantity& it : lattice->model->quantities) if (e.s.in(it.name)) comps += it.isVector ? 3 : 1;
+		std::vector<double> buf(n * comps, 0.0);
+		std::vector<real_t> tmp(inter.size() * 3);
+		int offset = 0;
+		for (const Model::Quantity& it : lattice->model->quantities) if (e.s.in(it.name)) {
+			int comp = it.isVector ? 3 : 1;
+			if (inter.size() > 0) {
+				double v = solver->units.alt(it.unit);
+				lattice->GetQuantity(it.id, inter, tmp.data(), 1/v);
+				for (int z=inter.dz; z<inter.dz+inter.nz; z++)
+				for (int y=inter.dy; y<inter.dy+inter.ny; y++)
+				for (int x=inter.dx; x<inter.dx+inter.nx; x++) {
+					for (int j=0; j<comp; j++) buf[e.reg.offset(x,y,z)*comps + offset + j] = tmp[inter.offset(x,y,z)*comp + j];
+				}
+			}
+			offset += comp;
+		}
+		// Every node of the line belongs to one rank
+		if (solver->mpi.rank == 0) {
+			MPI_Reduce(MPI_IN_PLACE, buf.data(), buf.size(), MPI_DOUBLE, MPI_SUM, 0, MPMD.local);
+		} else {
+			MPI_Reduce(buf.data(), NULL, buf.size(), MPI_DOUBLE, MPI_SUM, 0, MPMD.local);
+			return 0;
+		}
+		char fn[2*STRING_LEN];
+		solver->outIterFile(e.name.c_str(), ".csv", fn);
+		FILE * f = fopen(fn, "wt");
+		if (f == NULL) {
+			ERROR("Cannot open %s for writing\n", fn);
+			return -1;
+		}
+		fprintf(f, "\"x\",\"y\",\"z\"");
+		for (const Model::Quantity& it : lattice->model->quantities) if (e.s.in(it.name)) {
+			if (it.isVector) {
+				fprintf(f, ",\"%s_x\",\"%s_y\",\"%s_z\"", it.name.c_str(), it.name.c_str(), it.name.c_str());
+			} else {
+				fprintf(f, ",\"%s\"", it.name.c_str());
+			}
+		}
+		fprintf(f, "\n");
+		double spacing = 1/solver->units.alt("m");
+		for (int z=e.reg.dz; z<e.reg.dz+e.reg.nz; z++)
+		for (int y=e.reg.dy; y<e.reg.dy+e.reg.ny; y++)
+		for (int x=e.reg.dx; x<e.reg.dx+e.reg.nx; x++) {
+			fprintf(f, "%.13le, %.13le, %.13le", (lattice->px + x)*spacing, (lattice->py + y)*spacing, (lattice->pz + z)*spacing);
+			for (int j=0; j<comps; j++) fprintf(f, ", %.13le", buf[e.reg.offset(x,y,z)*comps + j]);
+			fprintf(f, "\n");
+		}
+		fclose(f);
+		return 0;
+	}
+
+
+int cbExtract::WriteIsosurface(Extract& e) {
+		Lattice * lattice = solver->lattice;
+		const Model::Quantity& q = lattice->model->quantities.by_id(e.quantity);
+		int comp = q.isVector ? 3 : 1;
+		MPIInfo& mpi = solver->mpi;
+		lbRegion total = mpi.totalregion;
+		lbRegion reg = lattice->region;
+		lbRegion ext = extendUp(reg).intersect(total);
+		std::vector<real_t> tmp(reg.size() * comp);
+		lattice->GetQuantity(q.id, reg, tmp.data(), 1);
+		std::vector<double> field(ext.size(), 0.0);
+		for (int z=reg.dz; z<reg.dz+reg.nz; z++)
+		for (int y=reg.dy; y<reg.dy+reg.ny; y++)
+		for (int x=reg.dx; x<reg.dx+reg.nx; x++) {
+			const real_t* val = &tmp[reg.offset(x,y,z)*comp];
+			double v = val[0];
+			if (comp == 3) v = sqrt(val[0]*val[0] + val[1]*val[1] + val[2]*val[2]);
+			field[ext.offset(x,y,z)] = v;
+		}
+
+		// The layer of nodes above the local region is taken from the neighbours
+		std::vector<int> scount(mpi.size, 0), sdispl(mpi.size, 0), rcount(mpi.size, 0), rdispl(mpi.size, 0);
+		std::vector<double> sbuf, rbuf;
+		for (int i=0; i<mpi.size; i++) if (i != mpi.rank) {
+			lbRegion other = mpi.node[i].region;
+			lbRegion send = reg.intersect(extendUp(other).intersect(total));
+			sdispl[i] = sbuf.size();
+			for (int z=send.dz; z<send.dz+send.nz; z++)
+			for (int y=send.dy; y<send.dy+send.ny; y++)
+			for (int x=send.dx; x<send.dx+send.nx; x++) sbuf.push_back(field[ext.offset(x,y,z)]);
+			scount[i] = sbuf.size() - sdispl[i];
+			lbRegion recv = other.intersect(ext);
+			rdispl[i] = i > 0 ? rdispl[i-1] + rcount[i-1] : 0;
+			rcount[i] = recv.size();
+		} else {
+			sdispl[i] = sbuf.size();
+			rdispl[i] = i > 0 ? rdispl[i-1] + rcount[i-1] : 0;
+		}
+		rbuf.resize(rdispl[mpi.size-1] + rcount[mpi.size-1]);
+		MPI_Alltoallv(sbuf.data(), scount.data(), sdispl.data(), MPI_DOUBLE, rbuf.data(), rcount.data(), rdispl.data(), MPI_DOUBLE, MPMD.local);
+		for (int i=0; i<mpi.size; i++) if (i != mpi.rank) {
+			lbRegion recv = mpi.node[i].region.intersect(ext);
+			size_t k = rdispl[i];
+			for (int z=recv.dz; z<recv.dz+recv.nz; z++)
+			for (int y=recv.dy; y<recv.dy+recv.ny; y++)
+			for (int x=recv.dx; x<recv.dx+recv.nx; x++) field[ext.offset(x,y,z)] = rbuf[k++];
+		}
+
+		// Marching tetrahedra (6 per cell) in 3D, and marching triangles (2 per cell) in 2D
+		static const int tets[6][4] = {{0,1,3,7},{0,3,2,7},{0,2,6,7},{0,6,4,7},{0,4,5,7},{0,5,1,7}};
+		static const int tris[2][3] = {{0,1,3},{0,3,2}};
+		bool d3 = total.nz > 1;
+		int nv = d3 ? 3 : 2;
+		double spacing = 1/solver->units.alt("m");
+		std::vector<double> pts;
+		int zend = d3 ? reg.dz+reg.nz : reg.dz+1;
+		for (int z=reg.dz; z<zend; z++) if (! d3 || z+1 < ext.dz+ext.nz)
+		for (int y=reg.dy; y<reg.dy+reg.ny; y++) if (y+1 < ext.dy+ext.ny)
+		for (int x=reg.dx; x<reg.dx+reg.nx; x++) if (x+1 < ext.dx+ext.nx) {
+			double p[8][3], v[8];
+			for (int c=0; c<(d3 ? 8 : 4); c++) {
+				int cx = x + (c & 1), cy = y + ((c >> 1) & 1), cz = z + ((c >> 2) & 1);
+				p[c][0] = (lattice->px + cx)*spacing;
+				p[c][1] = (lattice->py + cy)*spacing;
+				p[c][2] = (lattice->pz + cz)*spacing;
+				v[c] = field[ext.offset(cx,cy,cz)];
+			}
+			double sp[4][3], sv[4];
+			if (d3) {
+				for (int t=0; t<6; t++) {
+					for (int i=0; i<4; i++) { for (int j=0; j<3; j++) sp[i][j] = p[tets[t][i]][j]; sv[i] = v[tets[t][i]]; }
+					simplexIso(4, sp, sv, e.value, pts);
+				}
+			} else {
+				for (int t=0; t<2; t++) {
+					for (int i=0; i<3; i++) { for (int j=0; j<3; j++) sp[i][j] = p[tris[t][i]][j]; sv[i] = v[tris[t][i]]; }
+					simplexIso(3, sp, sv, e.value, pts);
+				}
+			}
+		}
+
+		// Gathering the elements on the first rank
+		int count = pts.size();
+		std::vector<int> counts(mpi.size), displs(mpi.size);
+		MPI_Gather(&count, 1, MPI_INT, counts.data(), 1, MPI_INT, 0, MPMD.local);
+		std::vector<double> all;
+		if (mpi.rank == 0) {
+			int sum = 0;
+			for (int i=0; i<mpi.size; i++) { displs[i] = sum; sum += counts[i]; }
+			all.resize(sum);
+		}
+		MPI_Gatherv(pts.data(), count, MPI_DOUBLE, all.data(), counts.data(), displs.data(), MPI_DOUBLE, 0, MPMD.local);
+		if (mpi.rank != 0) return 0;
+
+		char fn[2*STRING_LEN];
+		solver->outIterFile(e.name.c_str(), ".vtp", fn);
+		FILE * f = fopen(fn, "wt");
+		if (f == NULL) {
+			ERROR("Cannot open %s for writing\n", fn);
+			return -1;
+		}
+		size_t npoints = all.size() / 3;
+		size_t ncells = npoints / nv;
+		const char * cells = d3 ? "Polys" : "Lines";
+		fprintf(f, "<?xml version=\"1.0\"?>\n<VTKFile type=\"PolyData\" version=\"0.1\" byte_order=\"LittleEndian\">\n<PolyData>\n");
+		fprintf(f, "<Piece NumberOfPoints=\"%ld\" NumberOfVerts=\"0\" NumberOfLines=\"%ld\" NumberOfStrips=\"0\" NumberOfPolys=\"%ld\">\n", npoints, d3 ? 0 : ncells, d3 ? ncells : 0);
+		fprintf(f, "<Points>\n<DataArray type=\"Float64\" NumberOfComponents=\"3\" format=\"ascii\">\n");
+		for (size_t i=0; i<npoints; i++) fprintf(f, "%.9lg %.9lg %.9lg\n", all[3*i], all[3*i+1], all[3*i+2]);
+		fprintf(f, "</DataArray>\n</Points>\n<%s>\n<DataArray type=\"Int64\" Name=\"connectivity\" format=\"ascii\">\n", cells);
+		for (size_t i=0; i<npoints; i++) fprintf(f, "%ld\n", i);
+		fprintf(f, "</DataArray>\n<DataArray type=\"Int64\" Name=\"offsets\" format=\"ascii\">\n");
+		for (size_t i=0; i<ncells; i++) fprintf(f, "%ld\n", (i+1)*nv);
+		fprintf(f, "</DataArray>\n</%s>\n</Piece>\n</PolyData>\n</VTKFile>\n", cells);
+		fclose(f);
+		return 0;
+	}
+
+
+int cbExtract::DoIt () {
+		Callback::DoIt();
+		for (size_t i=0; i<extracts.size(); i++) {
+			Extract& e = extracts[i];
+			int ret = 0;
+			switch (e.type) {
+			case EXTRACT_SLICE:
+				ret = solver->writeVTK(e.name.c_str(), &e.s, e.reg);
+				break;
+			case EXTRACT_LINE:
+				ret = WriteLine(e);
+				break;
+			case EXTRACT_ISOSURFACE:
+				ret = WriteIsosurface(e);
+				break;
+			}
+			if (ret) return ret;
+		}
+		return 0;
+	}
+
+
+// Register the handler (basing on xmlname) in the Handler Factory
+template class HandlerFactory::Register< GenericAsk< cbExtract > >;
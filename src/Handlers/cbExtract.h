@@ -0,0 +1,39 @@
+#ifndef CBEXTRACT_H
+#define CBEXTRACT_H
+
+#include "../CommonHandler.h"
+
+#include "vHandler.h"
+#include "Callback.h"
+#include <vector>
+#include <string>
+
+/// Writes small extracts of the solution: slices, line probes and isosurfaces
+/**
+	Every child element is one extract:
+	- <Slice dz="..."/> writes a plane of the selected Quantities (vti),
+	- <Line dx="..." dy="..."/> writes a line of nodes along the axis not given (csv),
+	- <Isosurface what="..." value="..."/> writes the isosurface of a Quantity (vtp),
+	  which is extracted by every rank from its own part of the lattice.
+	Only the extracted data is gathered and written by the first rank.
+*/
+class  cbExtract  : public  Callback  {
+	enum extract_type_t { EXTRACT_SLICE, EXTRACT_LINE, EXTRACT_ISOSURFACE };
+	struct Extract {
+		extract_type_t type;
+		std::string name; ///< Name used in the output file name
+		name_set s; ///< Quantities to write (Slice and Line)
+		lbRegion reg; ///< Region of the Slice or Line
+		int quantity; ///< Index of the Quantity (Isosurface)
+		double value; ///< Value of the Quantity on the Isosurface (in lattice units)
+	};
+	std::vector<Extract> extracts;
+	int WriteLine(Extract& e);
+	int WriteIsosurface(Extract& e);
+	public:
+	static std::string xmlname;
+int Init ();
+int DoIt ();
+};
+
+#endif // CBEXTRACT_H
@@ -1,15 +1,12 @@
 #include "cbFailcheck.h"
+#include <limits>
 
 std::string cbFailcheck::xmlname = "Failcheck";
 
 int cbFailcheck::Init () {
 		Callback::Init();
 		currentlyactive = false;
-		reg.dx = solver->region.dx;
-		reg.dy = solver->region.dy;
-		reg.dz = solver->region.dz;
-	
-
+		reg = solver->region;
 
         pugi::xml_attribute attr = node.attribute("dx");
         if (attr) {
@@ -38,20 +35,7 @@ int cbFailcheck::Init () {
             reg.nz = solver->units.alt(attr.value());
         }
 
-		return 0;
-	}
-
-
-int cbFailcheck::DoIt () {
-		Callback::DoIt();
-	if (currentlyactive) return 0;
-	currentlyactive = true;
-       	int ret = 0;
-		int fin;
-		fin = false;
-
         pugi::xml_attribute comp = node.attribute("what");
- 
         name_set components;
         if(comp){
             components.add_from_string(comp.value(),',');
@@ -59,27 +43,48 @@ int cbFailcheck::DoIt () {
             components.add_from_string("all",',');
         }
 
+	for (int i=0; i<=QUANTITIES; i++) {
+		check.active[i] = false;
+		check.lower[i] = -std::numeric_limits<real_t>::infinity();
+		check.upper[i] = std::numeric_limits<real_t>::infinity();
+	}
 	for (const Model::Quantity& it : solver->lattice->model->quantities) {
 		if (it.isAdjoint) continue;
-            if (components.in(it.name)) {
-			int comp = 1;
-			if (it.isVector) comp = 3;
-                    real_t* tmp = new real_t[reg.size()*comp];
-		    solver->lattice->GetQuantity(it.id, reg, tmp, 1);
-                    bool cond = false;
-                    for (int k = 0; k < reg.size()*comp; k++){  
-	       		    cond = cond || (std::isnan(tmp[k]));
-                    }
-		    delete[] tmp;
-			MPI_Allreduce(&cond,&fin,1,MPI_INT,MPI_LOR,MPMD.local);
+		if (! components.in(it.name)) continue;
+		check.active[it.id] = true;
+		std::string nm;
+		nm = it.name + "Min";
+		attr = node.attribute(nm.c_str());
+		if (attr) check.lower[it.id] = solver->units.alt(attr.value());
+		nm = it.name + "Max";
+		attr = node.attribute(nm.c_str());
+		if (attr) check.upper[it.id] = solver->units.alt(attr.value());
+	}
+		return 0;
+	}
 
-                    if(fin ){
-			notice("Checking %s discovered NaN", it.name.c_str());
-			break;
-			}
-		}
 
-        }
+int cbFailcheck::DoIt () {
+		Callback::DoIt();
+	if (currentlyactive) return 0;
+	currentlyactive = true;
+       	int ret = 0;
+	unsigned long long int local[QUANTITIES+1], first[QUANTITIES+1];
+	solver->lattice->CheckQuantities(reg, check, local);
+	MPI_Allreduce(local, first, QUANTITIES, MPI_UNSIGNED_LONG_LONG, MPI_MIN, MPMD.local);
+
+	bool fin = false;
+	const lbRegion& tr = solver->mpi.totalregion;
+	for (const Model::Quantity& it : solver->lattice->model->quantities) {
+		if (! check.active[it.id]) continue;
+		if (first[it.id] == CHECK_NOT_FOUND) continue;
+		fin = true;
+		unsigned long long int idx = first[it.id];
+		int x = idx % tr.nx; idx /= tr.nx;
+		int y = idx % tr.ny; idx /= tr.ny;
+		int z = idx;
+		notice("Checking %s discovered NaN or value out of range (first at %d,%d,%d)", it.name.c_str(), x + tr.dx, y + tr.dy, z + tr.dz);
+	}
 	    if (fin) {
 			notice("NaN value discovered. Executing final actions from the Failcheck element before full stop...\n");
                 for (pugi::xml_node par = node.first_child(); par; par = par.next_sibling()) {
@@ -89,6 +94,7 @@ int cbFailcheck::DoIt () {
                 notice("Stopping due to Nan value\n");
                 ret = ITERATION_STOP;
             }
+	currentlyactive = false;
             return ret;
     }	
 
@@ -9,6 +9,7 @@
 class  cbFailcheck  : public  Callback  {
 	lbRegion reg;
 	bool currentlyactive;
+	QuantityCheck check;
 	public:
 	static std::string xmlname;
 int Init ();
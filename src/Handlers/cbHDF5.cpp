@@ -93,7 +93,19 @@ int cbHDF5::Init () {
 			return -1;
 		}
 
+		stride = 1;
+		attr = node.attribute("stride");
+		if (attr) stride = attr.as_int();
+		if (stride < 1) {
+			ERROR("HDF5 'stride' has to be a positive integer\n");
+			return -1;
+		}
+		average = false;
+		attr = node.attribute("average");
+		if (attr) average = attr.as_bool();
+
 		lbRegion local_reg = reg.intersect(solver->lattice->region);
+		if (stride > 1) local_reg = solver->lattice->region.coarse(reg, stride);
 
 		attr = node.attribute("chunk");
 		if (attr) {
@@ -136,7 +148,7 @@ int cbHDF5::Init () {
 int cbHDF5::DoIt () {
 #ifdef WITH_HDF5
 		Callback::DoIt();
-		return hdf5WriteLattice(nm.c_str(), solver, &s, chunkdim, options, reg);
+		return hdf5WriteLattice(nm.c_str(), solver, &s, chunkdim, options, reg, stride, average);
 #else
 		return -1;
 #endif
@@ -12,6 +12,8 @@ class  cbHDF5  : public  Callback  {
 	name_set s;
 	unsigned long int chunkdim[3];
 	unsigned int options;
+	int stride; ///< Write one value per stride^3 nodes
+	bool average; ///< Average the nodes, instead of taking every stride-th
 public:
 	static std::string xmlname;
 	int Init ();
@@ -0,0 +1,77 @@
+#include "cbLogSeries.h"
+std::string cbLogSeries::xmlname = "LogSeries";
+#include "../HandlerFactory.h"
+
+int cbLogSeries::Init () {
+		char fn[2*STRING_LEN];
+		Callback::Init();
+		pugi::xml_attribute attr = node.attribute("name");
+		std::string nm = "Series";
+		if (attr) nm = attr.value();
+		solver->outIterFile(nm.c_str(), ".csv", fn);
+		filename = fn;
+		Model * model = solver->lattice->model;
+		if (solver->mpi.rank == 0) {
+			FILE * f = fopen(filename.c_str(), "wt");
+			if (f == NULL) {
+				ERROR("Cannot open %s for writing\n", filename.c_str());
+				return -1;
+			}
+			fprintf(f,"\"Iteration\",\"Time_si\"");
+			for (const Model::Global& it : model->globals) {
+				fprintf(f,",\"%s\",\"%s_si\"", it.name.c_str(), it.name.c_str());
+			}
+			fprintf(f,"\n");
+			fclose(f);
+		}
+		int size = everyIter;
+		attr = node.attribute("buffer");
+		if (attr) size = attr.as_int();
+		if (size < 1) size = 1000;
+		solver->lattice->SeriesSize(size);
+		old_iter_type = solver->iter_type;
+		solver->iter_type |= ITER_SERIES;
+		return 0;
+	}
+
+
+int cbLogSeries::DoIt () {
+		Callback::DoIt();
+		Lattice * lattice = solver->lattice;
+		Model * model = lattice->model;
+		if (solver->mpi.rank == 0) {
+			FILE * f = fopen(filename.c_str(), "at");
+			if (f == NULL) {
+				ERROR("Cannot open %s for writing\n", filename.c_str());
+				return -1;
+			}
+			std::vector<double> scale;
+			for (const Model::Global& it : model->globals) scale.push_back(1/solver->units.alt(it.unit));
+			double dt = 1/solver->units.alt("s");
+			int offset = solver->iter - lattice->Iter;
+			for (size_t k=0; k<lattice->series_iter.size(); k++) {
+				int it = lattice->series_iter[k] + offset;
+				fprintf(f,"%d, %.13le", it, dt * it);
+				for (size_t i=0; i<scale.size(); i++) {
+					double v = lattice->series[k*GLOBALS + i];
+					fprintf(f,", %.13le, %.13le", v, v*scale[i]);
+				}
+				fprintf(f,"\n");
+			}
+			fclose(f);
+		}
+		lattice->series_iter.clear();
+		lattice->series.clear();
+		return 0;
+	}
+
+
+int cbLogSeries::Finish () {
+		solver->iter_type = old_iter_type;
+		solver->lattice->SeriesSize(0);
+		return Callback::Finish();
+	}
+
+
+// Register the handler (basing on xmlname) in the Handler Factory
+template class HandlerFactory::Register< GenericAsk< cbLogSeries > >;
@@ -0,0 +1,25 @@
+#ifndef CBLOGSERIES_H
+#define CBLOGSERIES_H
+
+#include "../CommonHandler.h"
+
+#include "vHandler.h"
+#include "Callback.h"
+
+/// Writes the Globals of every iteration to a csv file
+/**
+	The Globals are integrated on every iteration into a GPU ring buffer,
+	which is reduced across the ranks in one batch at the end of the segment,
+	so the segments are not broken into single iterations.
+*/
+class  cbLogSeries  : public  Callback  {
+	std::string filename;
+	int old_iter_type;
+	public:
+	static std::string xmlname;
+int Init ();
+int DoIt ();
+int Finish ();
+};
+
+#endif // CBLOGSERIES_H
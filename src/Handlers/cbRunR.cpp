@@ -2,9 +2,237 @@
 
 #ifdef WITH_R
 
+#include <Rversion.h>
+#if defined(R_VERSION) && R_VERSION >= R_Version(3,6,0)
+	#define WITH_ALTREP
+	#include <R_ext/Rdynload.h>
+	extern "C" {
+	#include <R_ext/Altrep.h>
+	}
+#endif
+#include <stdint.h>
+#include <string.h>
+#include <memory>
+
 #define rNull Rcpp::NumericVector(0)
 template <typename T> Rcpp::IntegerVector SingleInteger(T i) { Rcpp::IntegerVector v(1); v[0] = i; return v; }
 
+/// Snapshot of the values of a Quantity or Field (in the layout of the local region)
+/**
+	A snapshot never changes once filled: it is shared by all the R vectors and
+	NumPy arrays made from it, and lives as long as any of them. R has only
+	doubles, so in single precision the values are converted once per snapshot.
+*/
+class rStagingBuffer {
+	bool double_fresh; ///< data_double holds the values
+	std::vector<double> data_double;
+public:
+	lbRegion reg;
+	int comp;
+	std::vector<real_t> data;
+	rStagingBuffer() : double_fresh(false), comp(1) {}
+	inline size_t size() const { return reg.sizeL()*comp; }
+	inline void Filled() { double_fresh = false; }
+	double * Double() {
+	#ifdef CALC_DOUBLE_PRECISION
+		return data.data();
+	#else
+		if (!double_fresh) {
+			data_double.assign(data.begin(), data.end());
+			double_fresh = true;
+		}
+		return data_double.data();
+	#endif
+	}
+	/// Dimensions in R order (the component index runs fastest)
+	Rcpp::IntegerVector Dim() const {
+		Rcpp::IntegerVector retdim;
+		if (comp != 1) retdim.push_back(comp);
+		retdim.push_back(reg.nx);
+		retdim.push_back(reg.ny);
+		retdim.push_back(reg.nz);
+		return retdim;
+	}
+	/// Description of the values for a NumPy array (shape in C order)
+	SEXP PyBuffer(SEXP owner) const {
+		Rcpp::IntegerVector Shape;
+		Shape.push_back(reg.nz);
+		Shape.push_back(reg.ny);
+		Shape.push_back(reg.nx);
+		if (comp != 1) Shape.push_back(comp);
+		return Rcpp::List::create(
+			Rcpp::Named("address") = (double) (uintptr_t) data.data(),
+			Rcpp::Named("type") = (sizeof(real_t) == sizeof(double)) ? "double" : "float",
+			Rcpp::Named("shape") = Shape,
+			Rcpp::Named("owner") = owner
+		);
+	}
+};
+
+typedef std::shared_ptr<rStagingBuffer> rStagingPtr;
+
+/// Persistent host copy of a Quantity, Field or the flags
+/**
+	The copy is refreshed only when it is read after the lattice changed:
+	after an iteration, a switch of the lattice, or anything done from R/Python
+	or by another callback (see Invalidate). R gets the snapshot as an ALTREP
+	vector and Python as a read-only NumPy array, both without copying.
+	If a vector or array of the old snapshot is still alive at a refresh,
+	the new values go to a new buffer, so the old vector keeps its values.
+*/
+class rStaging {
+	enum kind_t { STAGING_QUANTITY, STAGING_FIELD, STAGING_FLAGS };
+	kind_t kind;
+	int id;
+	real_t scale;
+	int comp;
+	Solver * solver;
+	Lattice * lattice; ///< Lattice of the last refresh
+	int iter; ///< Iteration of the last refresh
+	long int generation; ///< Generation of the last refresh
+	rStagingPtr buffer; ///< The current snapshot
+	std::vector<flag_t> flags;
+	static long int current_generation;
+	static rStaging& Get(const std::string& key, Solver * solver, kind_t kind, int id, real_t scale, int comp) {
+		static std::map<std::string, rStaging> list;
+		rStaging& st = list[key];
+		if (st.solver != solver || st.kind != kind || st.id != id || st.scale != scale || st.comp != comp) {
+			st.kind = kind; st.id = id; st.scale = scale; st.comp = comp;
+			st.solver = solver;
+			st.lattice = NULL;
+		}
+		return st;
+	}
+	void Refresh() {
+		Lattice * now = solver->lattice;
+		if (now == lattice && now->Iter == iter && generation == current_generation) return;
+		lbRegion reg = now->region;
+		if (kind == STAGING_FLAGS) {
+			flags.resize(reg.sizeL());
+			now->GetFlags(reg, flags.data());
+		} else {
+			if (!buffer || buffer.use_count() > 1) buffer = std::make_shared<rStagingBuffer>();
+			buffer->reg = reg;
+			buffer->comp = comp;
+			buffer->data.resize(buffer->size());
+			if (kind == STAGING_QUANTITY) {
+				now->GetQuantity(id, reg, buffer->data.data(), scale);
+			} else {
+				now->Get_Field(id, buffer->data.data());
+			}
+			buffer->Filled();
+		}
+		lattice = now;
+		iter = now->Iter;
+		generation = current_generation;
+	}
+public:
+	rStaging() : kind(STAGING_QUANTITY), id(-1), scale(1), comp(1), solver(NULL), lattice(NULL), iter(0), generation(0) {}
+	/// Marks all the buffers as outdated (the lattice could have changed without iterating)
+	static void Invalidate() { current_generation++; }
+	static rStaging& Quantity(Solver * solver, const Model::Quantity& it, bool si) {
+		double v = 1;
+		if (si) v = solver->units.alt(it.unit);
+		return Get("Q:" + it.name + (si ? ".si" : ""), solver, STAGING_QUANTITY, it.id, 1/v, it.isVector ? 3 : 1);
+	}
+	static rStaging& Field(Solver * solver, const Model::Field& it) {
+		return Get("F:" + it.name, solver, STAGING_FIELD, it.id, 1, 1);
+	}
+	static rStaging& Flags(Solver * solver) {
+		return Get("flags", solver, STAGING_FLAGS, 0, 1, 1);
+	}
+	inline rStagingPtr Current() { Refresh(); return buffer; }
+	inline const flag_t * Flags() { Refresh(); return flags.data(); }
+	SEXP RVector();
+};
+
+long int rStaging::current_generation = 0;
+
+#ifdef WITH_ALTREP
+
+static R_altrep_class_t staging_class;
+
+/// The ALTREP vectors hold a reference to their snapshot in an external pointer (data1)
+/**
+	If a writeable pointer is requested (e.g. by C code which does not respect
+	the not-mutable mark), the vector gets its own copy of the values (data2),
+	so that the shared snapshot is never changed
+*/
+static inline rStagingBuffer * StagingPtr(SEXP x) { return ((rStagingPtr *) R_ExternalPtrAddr(R_altrep_data1(x)))->get(); }
+static inline bool StagingPrivate(SEXP x) { return R_altrep_data2(x) != R_NilValue; }
+static R_xlen_t Staging_Length(SEXP x) { return StagingPtr(x)->size(); }
+static void * Staging_Dataptr(SEXP x, Rboolean writeable) {
+	if (StagingPrivate(x)) return REAL(R_altrep_data2(x));
+	if (! writeable) return StagingPtr(x)->Double();
+	R_xlen_t n = Staging_Length(x);
+	SEXP copy = PROTECT(Rf_allocVector(REALSXP, n));
+	memcpy(REAL(copy), StagingPtr(x)->Double(), sizeof(double) * n);
+	R_set_altrep_data2(x, copy);
+	UNPROTECT(1);
+	return REAL(copy);
+}
+static const void * Staging_Dataptr_or_null(SEXP x) {
+	if (StagingPrivate(x)) return REAL(R_altrep_data2(x));
+	return StagingPtr(x)->Double();
+}
+static double Staging_Elt(SEXP x, R_xlen_t i) {
+	if (StagingPrivate(x)) return REAL(R_altrep_data2(x))[i];
+	return StagingPtr(x)->Double()[i];
+}
+
+static void StagingFinalize(SEXP ptr) {
+	rStagingPtr * p = (rStagingPtr *) R_ExternalPtrAddr(ptr);
+	if (p == NULL) return;
+	delete p;
+	R_ClearExternalPtr(ptr);
+}
+
+static void StagingInit(DllInfo * dll) {
+	staging_class = R_make_altreal_class("CLBStaging", "TCLB", dll);
+	R_set_altrep_Length_method(staging_class, Staging_Length);
+	R_set_altvec_Dataptr_method(staging_class, Staging_Dataptr);
+	R_set_altvec_Dataptr_or_null_method(staging_class, Staging_Dataptr_or_null);
+	R_set_altreal_Elt_method(staging_class, Staging_Elt);
+}
+
+/// ALTREP vector reading the current snapshot. It is marked as not mutable, so R copies it before any modification
+SEXP rStaging::RVector() {
+	SEXP ptr = PROTECT(R_MakeExternalPtr(new rStagingPtr(Current()), R_NilValue, R_NilValue));
+	R_RegisterCFinalizerEx(ptr, StagingFinalize, TRUE);
+	SEXP ret = PROTECT(R_new_altrep(staging_class, ptr, R_NilValue));
+	Rf_setAttrib(ret, R_DimSymbol, StagingPtr(ret)->Dim());
+	MARK_NOT_MUTABLE(ret);
+	UNPROTECT(2);
+	return ret;
+}
+
+/// Description of the snapshot of a vector for a NumPy array (NULL for other vectors)
+/**
+	The owner element is the external pointer of the vector, which the
+	NumPy array keeps, so that the snapshot lives as long as the array.
+	A vector with its own copy of the values is converted as a standard one.
+*/
+SEXP CLBBuffer(SEXP x) {
+	if (ALTREP(x) && R_altrep_inherits(x, staging_class) && ! StagingPrivate(x)) return StagingPtr(x)->PyBuffer(R_altrep_data1(x));
+	return R_NilValue;
+}
+
+#else
+
+SEXP rStaging::RVector() {
+	rStagingPtr buf = Current();
+	double * ptr = buf->Double();
+	Rcpp::NumericVector ret(ptr, ptr + buf->size());
+	ret.attr("dim") = buf->Dim();
+	return ret;
+}
+
+SEXP CLBBuffer(SEXP x) {
+	return R_NilValue;
+}
+
+#endif
+
 class rWrapper { // Wrapper for all my R objects
 public:
 	Solver * solver;
@@ -52,6 +280,7 @@ public:
                         return;
                 }
 		solver->lattice->zSet.set(idx, zone_number, v[0]);
+		rStaging::Invalidate();
 	}
 	Rcpp::CharacterVector Names() {
 		Rcpp::CharacterVector ret;
@@ -82,6 +311,7 @@ public:
 		if (set) {
 			Rcpp::NumericVector v(v_);
 			solver->lattice->SetSetting(set, v[0]);
+			rStaging::Invalidate();
 		} else {
 			ERROR("R: Unknown setting");
 		}
@@ -107,17 +337,7 @@ public:
 			ERROR("R: Unknown parameter");
 			return Rcpp::NumericVector(0);
 		}
-		lbRegion reg = solver->lattice->region;
-		std::vector<real_t> vec;
-		vec.resize(reg.size());
-	    solver->lattice->Get_Field(it.id, &vec[0]);
-		Rcpp::NumericVector ret(vec.begin(),vec.end());
-		Rcpp::IntegerVector retdim(3);
-		retdim[0] = reg.nx;
-		retdim[1] = reg.ny;
-		retdim[2] = reg.nz;
-		ret.attr("dim") = retdim;
-		return ret;
+		return rStaging::Field(solver, it).RVector();
 	}
 
 	void DollarAssign(std::string name, SEXP v_) {
@@ -133,6 +353,7 @@ public:
 		}
 		std::vector<real_t> vec(v.begin(),v.end());
 	    solver->lattice->Set_Field(it.id,&vec[0]); 
+		rStaging::Invalidate();
 		return;
 	}
 	Rcpp::CharacterVector Names() {
@@ -182,6 +403,7 @@ public:
 		}
 		if (name == "Values") {
 			hand->Parameters(PAR_SET, &v[0]);
+			rStaging::Invalidate();
 		} else {
 			ERROR("R: Cannot set anything but Values");
 			return;
@@ -206,8 +428,6 @@ class rQuantities : public rWrapper {
 public:
 	std::string print() { return "Quantities"; }
 	SEXP Dollar(std::string name) {
-		lbRegion reg = solver->lattice->region;
-		Rcpp::NumericVector ret;
 		bool si = false;
 		std::string quant = name;
 		size_t last_index = name.find_last_of(".");
@@ -223,32 +443,7 @@ public:
 			ERROR("R: Unknown Quantity");
 			return Rcpp::NumericVector(0);
 		}
-		double v = 1;
-		if (si) v = solver->units.alt(it.unit);
-		int comp = 1;
-		if (it.isVector) comp = 3;
-		real_t* tmp = new real_t[reg.size()*comp];
-                solver->lattice->GetQuantity(it.id, reg, tmp, 1/v);
-		ret = Rcpp::NumericVector(reg.size()*comp);
-		if (comp != 1) {
-			Rcpp::IntegerVector retdim(4);
-			retdim[0] = comp;
-			retdim[1] = reg.nx;
-			retdim[2] = reg.ny;
-			retdim[3] = reg.nz;
-			ret.attr("dim") = retdim;
-		} else {
-			Rcpp::IntegerVector retdim(3);
-			retdim[0] = reg.nx;
-			retdim[1] = reg.ny;
-			retdim[2] = reg.nz;
-			ret.attr("dim") = retdim;
-		}
-		for (size_t i=0; i<reg.sizeL()*comp; i++) {
-			ret[i] = tmp[i];
-		}
-		delete[] tmp;
-		return ret;
+		return rStaging::Quantity(solver, it, si).RVector();
 	}
 	Rcpp::CharacterVector Names() {
 		Rcpp::CharacterVector ret;
@@ -315,6 +510,7 @@ public:
 		const Model::Action& it = solver->lattice->model->actions.by_name(name);
 		if (it) {
 			solver->lattice->RunAction(it.id, solver->iter_type);
+			rStaging::Invalidate();
 		} else {
 			ERROR("R: Unknown Action");
 		}
@@ -366,6 +562,7 @@ public:
 		}
 		solver->lattice->FlagOverwrite(NodeType, reg);
 		delete[] NodeType;
+		rStaging::Invalidate();
 		return;
 	}
 
@@ -412,8 +609,7 @@ SEXP Dollar(std::string name) {
 		ERROR("Geometry component not found: %s\n", name.c_str());
 		return rNull;
 	}		
-		flag_t * NodeType = new flag_t[size];
-		solver->lattice->GetFlags(reg, NodeType);
+		const flag_t * NodeType = rStaging::Flags(solver).Flags();
 		Rcpp::IntegerVector small(size);
 		small.attr("dim") = retdim;
 		for (size_t i=0;i<size;i++) {
@@ -438,7 +634,6 @@ SEXP Dollar(std::string name) {
 			small.attr("levels") = levels;
 		}
 		small.attr("class") = "factor";
-		delete[] NodeType;
 		return small;
 	}
 	virtual Rcpp::CharacterVector Names() {
@@ -535,6 +730,7 @@ public:
 	                                error("No support for CALLBACK XML elements with Iterations set in RunR");
                                 } else {
                                         hand.DoIt();
+                                        rStaging::Invalidate();
                                 }
                         }
                 };
@@ -645,12 +841,16 @@ namespace RunR {
 			R["[[<-.CLB"]        = Rcpp::InternalFunction( &CLBDollarAssign );
 			R["print.CLB"]       = Rcpp::InternalFunction( &CLBPrint );
 			R["names.CLB"]       = Rcpp::InternalFunction( &CLBNames );
+			R["CLBBuffer"]       = Rcpp::InternalFunction( &CLBBuffer );
 			R.parseEval("'CLBFunctionWrap' <- function(obj) { function(...) CLBFunctionCall(obj, list(...)); }");
 			ptr_R_WriteConsoleEx = CLB_WriteConsoleEx ;
 			ptr_R_WriteConsole = NULL;
 			R_Outputfile = NULL;
 			R_Consolefile = NULL;
 			R.parseEval("options(prompt='[  ] R:> ');");
+#ifdef WITH_ALTREP
+			StagingInit(R_getEmbeddingDllInfo());
+#endif
 		}
 		return *Rptr;
 	};
@@ -709,12 +909,28 @@ namespace RunPython {
 			"  if (is.factor(ret)) {                                               \n"
 			"    as.integer(ret) - 1L                                              \n"
 			"  } else {                                                            \n"
-			"    ret                                                               \n"
+			"    buf = CLBBuffer(ret)                                              \n"
+			"    if (is.null(buf) || is.null(py$CLBArray)) ret else py$CLBArray(buf[c('address','type','shape')], reticulate:::py_capsule(buf$owner))\n"
 			"  }                                                                   \n"
 			"}                                                                     \n"
 			"py_element_assign = function(obj, name, value) `[[<-`(obj,name,value) \n"
 			"r_to_py.CLB = function(x, convert=FALSE) py$S3(reticulate:::py_capsule(x))\n"
 		);
+		parseEval(
+			"try:                                                                  \n"
+			"  import ctypes, numpy                                                \n"
+			"  def CLBArray(buf, owner):                                           \n"
+			"    double = buf['type'] == 'double'                                  \n"
+			"    tp = ctypes.c_double if double else ctypes.c_float                \n"
+			"    shape = tuple(int(i) for i in buf['shape'])                       \n"
+			"    arr = (tp * int(numpy.prod(shape))).from_address(int(buf['address']))\n"
+			"    arr._owner = owner                                                \n"
+			"    ret = numpy.frombuffer(arr, dtype=numpy.float64 if double else numpy.float32).reshape(shape)\n"
+			"    ret.flags.writeable = False                                       \n"
+			"    return ret                                                        \n"
+			"except ImportError:                                                   \n"
+			"  CLBArray = None                                                     \n"
+		);
 		parseEval(
 			"class S3:                                                             \n"
 			"  def __init__(self, obj):                                            \n"
@@ -805,6 +1021,7 @@ int cbRunR::s_tag = 0;
 
 int cbRunR::DoIt() {
 	try {
+		rStaging::Invalidate();
 		if (source != "") {
 			output("%8d it Executing %s code %03d\n", solver->iter, node.name(), tag);
 			if (python) {
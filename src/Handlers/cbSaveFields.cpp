@@ -0,0 +1,71 @@
+#include "cbSaveFields.h"
+std::string cbSaveFields::xmlname = "SaveFields";
+#include "../HandlerFactory.h"
+
+int cbSaveFields::Init () {
+		Callback::Init();
+		pugi::xml_attribute attr = node.attribute("file");
+		if (!attr) {
+			attr = node.attribute("filename");
+			if (attr) fn = attr.value();
+		} else {
+			fn = ((std::string) solver->info.outpath) + "_" + attr.value();
+		}
+		return 0;
+	}
+
+
+int cbSaveFields::DoIt () {
+		Callback::DoIt();
+		char filename[2*STRING_LEN];
+		if (fn == "") {
+			solver->outIterCollectiveFile("Fields", "", filename);
+		} else {
+			sprintf(filename, "%s", fn.c_str());
+		}
+		char fname[2*STRING_LEN+20];
+		sprintf(fname, "%s_%d.fields", filename, D_MPI_RANK);
+		output("Saving all fields to %s\n", fname);
+		lbRegion reg = solver->region;
+		size_t n = reg.sizeL();
+		real_t * tab = new real_t[FIELDS * n];
+		solver->lattice->GetFields(tab);
+		// Header: number of fields, global size and the local region, so that the file can be read on any decomposition
+		int head[10] = { FIELDS, solver->info.region.nx, solver->info.region.ny, solver->info.region.nz, reg.dx, reg.dy, reg.dz, reg.nx, reg.ny, reg.nz };
+		// Index: the headers of all the files, so that a reader opens only the files it needs
+		std::vector<int> heads(10 * solver->mpi_size);
+		MPI_Gather(head, 10, MPI_INT, heads.data(), 10, MPI_INT, 0, MPMD.local);
+		if (D_MPI_RANK == 0) {
+			char iname[2*STRING_LEN+20];
+			sprintf(iname, "%s.index", filename);
+			FILE * f = fopen(iname, "wb");
+			if (f == NULL) {
+				ERROR("Cannot open %s for output\n", iname);
+				delete[] tab;
+				return -1;
+			}
+			int parts = solver->mpi_size;
+			fwrite(&parts, sizeof(int), 1, f);
+			fwrite(heads.data(), sizeof(int), heads.size(), f);
+			fclose(f);
+		}
+		FILE * f = fopen(fname, "wb");
+		if (f == NULL) {
+			ERROR("Cannot open %s for output\n", fname);
+			delete[] tab;
+			return -1;
+		}
+		fwrite(head, sizeof(int), 10, f);
+		std::vector<double> buf(n);
+		for (int k=0; k<FIELDS; k++) {
+			for (size_t i=0; i<n; i++) buf[i] = tab[k*n + i];
+			fwrite(&buf[0], sizeof(double), n, f);
+		}
+		fclose(f);
+		delete[] tab;
+		return 0;
+	};
+
+
+// Register the handler (basing on xmlname) in the Handler Factory
+template class HandlerFactory::Register< GenericAsk< cbSaveFields > >;
@@ -0,0 +1,17 @@
+#ifndef CBSAVEFIELDS_H
+#define CBSAVEFIELDS_H
+
+#include "../CommonHandler.h"
+
+#include "vHandler.h"
+#include "Callback.h"
+
+class  cbSaveFields  : public  Callback  {
+	std::string fn;
+	public:
+	static std::string xmlname;
+int Init ();
+int DoIt ();
+};
+
+#endif // CBSAVEFIELDS_H
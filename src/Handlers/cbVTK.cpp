@@ -14,6 +14,47 @@ int cbVTK::Init () {
 			s.add_from_string("all",',');
 		}
 
+		use_codec = false;
+		attr = node.attribute("compress");
+		if (attr) {
+			compress.add_from_string(attr.value(),',');
+			use_codec = true;
+			pugi::xml_attribute accuracy = node.attribute("accuracy");
+			pugi::xml_attribute rate = node.attribute("rate");
+			if (accuracy && rate) {
+				ERROR("Only one of 'accuracy' and 'rate' can be set in VTK\n");
+				return -1;
+			} else if (accuracy) {
+				double val = accuracy.as_double();
+				if (val <= 0) {
+					ERROR("VTK 'accuracy' has to be positive\n");
+					return -1;
+				}
+				codec.setAccuracy(val);
+			} else if (rate) {
+				double val = rate.as_double();
+				if (val <= 0 || val > 64) {
+					ERROR("VTK 'rate' has to be between 0 and 64 bits per value\n");
+					return -1;
+				}
+				codec.setRate(val);
+			} else {
+				ERROR("VTK with 'compress' needs 'accuracy' or 'rate'\n");
+				return -1;
+			}
+		}
+
+		stride = 1;
+		attr = node.attribute("stride");
+		if (attr) stride = attr.as_int();
+		if (stride < 1) {
+			ERROR("VTK 'stride' has to be a positive integer\n");
+			return -1;
+		}
+		average = false;
+		attr = node.attribute("average");
+		if (attr) average = attr.as_bool();
+
 		reg = solver->mpi.totalregion;
 	
 		attr = node.attribute("dx");
@@ -60,7 +101,8 @@ int cbVTK::Init () {
 
 int cbVTK::DoIt () {
 		Callback::DoIt();
-		return solver->writeVTK(nm.c_str(), &s, reg);
+		if (use_codec) return solver->writeVTK(nm.c_str(), &s, reg, &compress, &codec, stride, average);
+		return solver->writeVTK(nm.c_str(), &s, reg, NULL, NULL, stride, average);
 	};
 
 
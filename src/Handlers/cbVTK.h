@@ -10,6 +10,11 @@ class  cbVTK  : public  Callback  {
 	lbRegion reg;
 	std::string nm;
 	name_set s;
+	name_set compress; ///< Quantities written with the lossy codec
+	BlockCompressor codec;
+	bool use_codec;
+	int stride; ///< Write one value per stride^3 nodes
+	bool average; ///< Average the nodes, instead of taking every stride-th
 	public:
 	static std::string xmlname;
 int Init ();
@@ -3,6 +3,7 @@
 
 vHandler::vHandler() {
 	parSize= -1;
+	localParSize= -1;
 }
 
 int vHandler::DoIt() {
@@ -61,3 +62,33 @@ int vHandler::Parameters (int type, double * tab) {
 		return 0;
 	};
 
+
+int vHandler::NumberOfLocalParameters () {
+		if (localParSize < 0) {
+			localParSize = 0;
+			for (size_t i=0; i<solver->hands.size(); i++) if (solver->hands[i].Type()  == HANDLER_DESIGN) {
+				int k = solver->hands[i]->NumberOfLocalParameters();
+				localParSize += k;
+			}
+			debug1("Local parameters: %d\n", localParSize);
+		}
+		return localParSize;
+	};
+
+
+int vHandler::LocalParameters (int type, double * tab) {
+		int offset = 0, size = 0, ret=0;
+		for (size_t i=0; i<solver->hands.size(); i++) if (solver->hands[i].Type()  == HANDLER_DESIGN) {
+			size = solver->hands[i]->NumberOfLocalParameters();
+			if (offset + size > localParSize) { offset = offset + size; break; }
+			ret = solver->hands[i]->LocalParameters(type, tab+offset);
+			if (ret) return ret;
+			offset += size;
+		}
+		if (offset != localParSize) {
+				ERROR("Numer of local parameters is inconsistent with first call to NumberOfLocalParameters (in LocalParameters(%d)!", type);
+				exit(-1);
+				return -1;
+		}
+		return 0;
+	};
@@ -48,6 +48,12 @@ class vHandler {
 	inline  int GetParameters(double * data) { return this->Parameters(PAR_GET, data); };
 	inline  int SetParameters(const double *data) {return this->Parameters(PAR_SET, const_cast<double *>(data));}; ///< Return the type of the Handler
 	inline  int GetGradient(double * data) { return this->Parameters(PAR_GRAD, data); }; ///< Return the type of the Handler
+	int localParSize;
+	virtual int NumberOfLocalParameters(); ///< Number of parameters kept on this processor
+	virtual int LocalParameters(int type, double* data); ///< Like Parameters, but on the part of the vector kept on this processor
+	inline  int GetLocalParameters(double * data) { return this->LocalParameters(PAR_GET, data); };
+	inline  int SetLocalParameters(const double *data) {return this->LocalParameters(PAR_SET, const_cast<double *>(data));};
+	inline  int GetLocalGradient(double * data) { return this->LocalParameters(PAR_GRAD, data); };
 	
 	inline pugi::xml_attribute context_attribute(const char* name) {
 		pugi::xml_node n = node;
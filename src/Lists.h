@@ -108,6 +108,16 @@ public:
             , isAdjoint(isAdjoint_), adjointName(adjointName_), tangentName(tangentName_) {}
     };
 
+    struct Density : Thing {
+        int fieldId;
+        int dx, dy, dz;
+        std::string group;
+        inline Density() : fieldId(INVALID_ID), dx(0), dy(0), dz(0), group("invalid") {}
+        inline Density(const int& id_, const std::string& name_, const int& fieldId_,
+                const int& dx_, const int& dy_, const int& dz_, const std::string& group_)
+            : Thing(id_,name_), fieldId(fieldId_), dx(dx_), dy(dy_), dz(dz_), group(group_) {}
+    };
+
     struct Action : Thing {
         std::vector<int> stages;
         inline Action() {}
@@ -150,6 +160,8 @@ public:
     Scales scales;
     typedef Things<Field> Fields;
     Fields fields;
+    typedef Things<Density> Densities;
+    Densities densities;
     typedef Things<Action> Actions;
     Actions actions;
     typedef Things<Stage> Stages;
@@ -0,0 +1,483 @@
+#include <mpi.h>
+#include "Consts.h"
+#include "Global.h"
+#include "cross.h"
+#include "types.h"
+#include "Refinement.h"
+#include "Lattice.h"
+#include <functional>
+#include <cmath>
+#include <algorithm>
+
+/// Copy the part of a box of values (comp values per node, in the GetFields layout) to another box
+template <class T>
+static void CopyBox(lbRegion from, const T * src, lbRegion to, T * dst, int comp)
+{
+	lbRegion inter = from.intersect(to);
+	size_t nf = from.sizeL(), nt = to.sizeL();
+	for (int c=0; c<comp; c++)
+	for (int z=inter.dz; z<inter.dz+inter.nz; z++)
+	for (int y=inter.dy; y<inter.dy+inter.ny; y++)
+	for (int x=inter.dx; x<inter.dx+inter.nx; x++)
+		dst[to.offsetL(x,y,z) + c*nt] = src[from.offsetL(x,y,z) + c*nf];
+}
+
+/// Exchange boxes of values between the processors
+/**
+  Every processor gets the values over its box want[rank] from the processors
+  having them (have[i] for processor i). The boxes in have cannot overlap.
+  \param have Boxes of values provided by the processors
+  \param want Boxes of values wanted by the processors
+  \param comp Number of values per node
+  \param get Function filling the values over a part of have[rank]
+  \param out Values over want[rank] (comp values per node, in the GetFields layout)
+*/
+template <class T>
+static void ExchangeBoxes(const std::vector<lbRegion>& have, const std::vector<lbRegion>& want, int comp, std::function<void(lbRegion, T*)> get, T * out)
+{
+	int size = have.size(), rank;
+	MPI_Comm_rank(MPMD.local, &rank);
+	std::vector<int> scount(size), sdisp(size), rcount(size), rdisp(size);
+	std::vector<lbRegion> spart(size), rpart(size);
+	int ssize = 0, rsize = 0;
+	for (int i=0; i<size; i++) {
+		lbRegion h = have[rank], r = have[i];
+		spart[i] = h.intersect(want[i]);
+		rpart[i] = r.intersect(want[rank]);
+		scount[i] = comp * spart[i].size();
+		rcount[i] = comp * rpart[i].size();
+		sdisp[i] = ssize;
+		rdisp[i] = rsize;
+		ssize += scount[i];
+		rsize += rcount[i];
+	}
+	std::vector<T> sbuf(ssize), rbuf(rsize);
+	for (int i=0; i<size; i++) if (scount[i] > 0) get(spart[i], sbuf.data() + sdisp[i]);
+	MPI_Datatype tp;
+	MPI_Type_contiguous(sizeof(T), MPI_BYTE, &tp);
+	MPI_Type_commit(&tp);
+	MPI_Alltoallv(sbuf.data(), scount.data(), sdisp.data(), tp, rbuf.data(), rcount.data(), rdisp.data(), tp, MPMD.local);
+	MPI_Type_free(&tp);
+	for (int i=0; i<size; i++) if (rcount[i] > 0) CopyBox(rpart[i], rbuf.data() + rdisp[i], want[rank], out, comp);
+}
+
+/// Weight of a velocity (with square length c2) in the D2Q9, D3Q15, D3Q19 and D3Q27 velocity sets (0 if not known)
+static double LatticeWeight(int dim, int q, int c2)
+{
+	if ((dim == 2) && (q == 9)) {
+		const double w[] = { 4./9., 1./9., 1./36. };
+		if (c2 < 3) return w[c2];
+	} else if ((dim == 3) && (q == 15)) {
+		const double w[] = { 2./9., 1./9., 0., 1./72. };
+		if (c2 < 4) return w[c2];
+	} else if ((dim == 3) && (q == 19)) {
+		const double w[] = { 1./3., 1./18., 1./36. };
+		if (c2 < 3) return w[c2];
+	} else if ((dim == 3) && (q == 27)) {
+		const double w[] = { 8./27., 2./27., 1./54., 1./216. };
+		if (c2 < 4) return w[c2];
+	}
+	return 0;
+}
+
+RefinePatch::RefinePatch(Lattice * parent_, lbRegion patch_, int ring_) : parent(parent_), patch(patch_), ring(ring_), lattice(NULL) {
+	nu_id = INVALID_ID;
+	alpha_cf = alpha_fc = 1;
+	ratio[0] = ratio[1] = ratio[2] = 1;
+}
+
+RefinePatch::~RefinePatch() {
+	if (lattice != NULL) delete lattice;
+}
+
+/// Position of the center of the i-th fine node in the k direction (in the parent nodes)
+double RefinePatch::Position(int k, int i)
+{
+	int d[3] = { patch.dx, patch.dy, patch.dz };
+	if (ratio[k] == 1) return d[k] + i;
+	return d[k] + 0.5*i - 0.25;
+}
+
+/// Box of the parent nodes needed to interpolate over a box of the fine nodes
+lbRegion RefinePatch::Stencil(lbRegion fine)
+{
+	if (fine.size() == 0) return lbRegion(0,0,0,0,0,0);
+	int d[3] = { fine.dx, fine.dy, fine.dz }, n[3] = { fine.nx, fine.ny, fine.nz };
+	int rd[3], rn[3];
+	for (int k=0; k<3; k++) {
+		rd[k] = (int) floor(Position(k, d[k]));
+		rn[k] = (int) floor(Position(k, d[k] + n[k] - 1)) - rd[k] + 1;
+		if (ratio[k] != 1) rn[k] ++;
+	}
+	return lbRegion(rd[0], rd[1], rd[2], rn[0], rn[1], rn[2]);
+}
+
+/// Box of the parent nodes containing a box of the fine nodes
+lbRegion RefinePatch::Parents(lbRegion fine)
+{
+	if (fine.size() == 0) return lbRegion(0,0,0,0,0,0);
+	int d[3] = { fine.dx, fine.dy, fine.dz }, n[3] = { fine.nx, fine.ny, fine.nz }, pd[3] = { patch.dx, patch.dy, patch.dz };
+	int rd[3], rn[3];
+	for (int k=0; k<3; k++) {
+		rd[k] = pd[k] + d[k] / ratio[k];
+		rn[k] = pd[k] + (d[k] + n[k] - 1) / ratio[k] - rd[k] + 1;
+	}
+	return lbRegion(rd[0], rd[1], rd[2], rn[0], rn[1], rn[2]);
+}
+
+/// Box of the fine nodes contained in a box of the parent nodes
+lbRegion RefinePatch::Children(lbRegion coarse)
+{
+	if (coarse.size() == 0) return lbRegion(0,0,0,0,0,0);
+	return lbRegion((coarse.dx - patch.dx) * ratio[0], (coarse.dy - patch.dy) * ratio[1], (coarse.dz - patch.dz) * ratio[2],
+		coarse.nx * ratio[0], coarse.ny * ratio[1], coarse.nz * ratio[2]);
+}
+
+/// Gather the Fields of the parent over the box want[rank] (has to be called on all processors)
+void RefinePatch::GatherParent(const std::vector<lbRegion>& want, std::vector<real_t>& tab)
+{
+	std::vector<lbRegion> have(mpi.size);
+	for (int i=0; i<mpi.size; i++) have[i] = parent->mpi.node[i].region;
+	lbRegion my = want[mpi.rank];
+	tab.resize(((size_t) FIELDS) * my.sizeL());
+	Lattice * lat = parent;
+	ExchangeBoxes<real_t>(have, want, FIELDS, [lat](lbRegion r, real_t * buf) { lat->GetFields(r, buf); }, tab.data());
+}
+
+/// Interpolate the Fields of the parent over a box of the fine nodes
+/**
+  \param fine Box of the fine nodes
+  \param box Box of the parent nodes (containing the Stencil of fine)
+  \param a Fields of the parent over box (at time t=0)
+  \param b Fields of the parent over box (at time t=1, not used if t=0)
+  \param t Time (between 0 and 1)
+  \param tab Fields over fine
+*/
+void RefinePatch::Interpolate(lbRegion fine, lbRegion box, const real_t * a, const real_t * b, double t, real_t * tab)
+{
+	size_t n = fine.sizeL(), m = box.sizeL();
+	for (int z=fine.dz; z<fine.dz+fine.nz; z++)
+	for (int y=fine.dy; y<fine.dy+fine.ny; y++)
+	for (int x=fine.dx; x<fine.dx+fine.nx; x++) {
+		int i[3] = { x, y, z }, j[3];
+		double s[3];
+		for (int k=0; k<3; k++) {
+			double p = Position(k, i[k]);
+			j[k] = (int) floor(p);
+			s[k] = p - j[k];
+		}
+		size_t o = fine.offsetL(x,y,z);
+		for (int f=0; f<FIELDS; f++) tab[o + f*n] = 0;
+		for (int c=0; c<8; c++) {
+			double wc = 1;
+			int p[3];
+			for (int k=0; k<3; k++) {
+				if ((c >> k) & 1) {
+					wc *= s[k];
+					p[k] = j[k] + 1;
+				} else {
+					wc *= 1 - s[k];
+					p[k] = j[k];
+				}
+			}
+			if (wc == 0) continue;
+			size_t q = box.offsetL(p[0], p[1], p[2]);
+			for (int f=0; f<FIELDS; f++) {
+				double v = a[q + f*m];
+				if (t != 0) v = (1-t)*v + t*b[q + f*m];
+				tab[o + f*n] += wc*v;
+			}
+		}
+	}
+}
+
+/// Rescale the non-equilibrium part of the densities of the group
+void RefinePatch::Rescale(real_t * tab, size_t n, double alpha)
+{
+	if (alpha == 1) return;
+	size_t Q = group.size();
+	std::vector<double> f(Q);
+	for (size_t i=0; i<n; i++) {
+		double rho = 0, ux = 0, uy = 0, uz = 0;
+		for (size_t k=0; k<Q; k++) {
+			f[k] = tab[i + group[k]*n];
+			rho += f[k];
+			ux += cx[k]*f[k];
+			uy += cy[k]*f[k];
+			uz += cz[k]*f[k];
+		}
+		if (! (rho > 0)) continue;
+		ux /= rho; uy /= rho; uz /= rho;
+		double usq = ux*ux + uy*uy + uz*uz;
+		for (size_t k=0; k<Q; k++) {
+			double cu = cx[k]*ux + cy[k]*uy + cz[k]*uz;
+			double feq = w[k]*rho*(1 + 3*cu + 4.5*cu*cu - 1.5*usq);
+			tab[i + group[k]*n] = feq + alpha*(f[k] - feq);
+		}
+	}
+}
+
+/// Copy the (scaled) Settings of the parent to the fine Lattice, if they changed
+void RefinePatch::SyncSettings()
+{
+	bool changed = false;
+	for (int i=0; i<SETTINGS; i++) if (synced[i] != parent->settings[i]) changed = true;
+	if (! changed) return;
+	for (const Model::Setting& set : parent->model->settings) {
+		if (scale[set.id] != 0) lattice->SetSetting(set, parent->settings[set.id] * scale[set.id]);
+	}
+	for (int i=0; i<SETTINGS; i++) synced[i] = parent->settings[i];
+	// The Fields are the densities after collision, so the non-equilibrium part scales with (tau - 1) * dx
+	double tau_c = 3*parent->settings[nu_id] + 0.5;
+	double tau_f = 3*lattice->settings[nu_id] + 0.5;
+	if (fabs(tau_c - 1) < 1e-10 || fabs(tau_f - 1) < 1e-10) {
+		warning("Refinement with relaxation time 1 (nu = 1/6): the non-equilibrium part is not rescaled\n");
+		alpha_cf = 1;
+	} else {
+		alpha_cf = (tau_f - 1) / (2*(tau_c - 1));
+	}
+	alpha_fc = 1 / alpha_cf;
+}
+
+/// Set the ring of the fine Lattice from the parent at time t (between the gathered t and t+1)
+void RefinePatch::SetRing(double t)
+{
+	for (size_t b=0; b<ring_boxes.size(); b++) {
+		lbRegion loc = lattice->region.intersect(ring_boxes[b]);
+		std::vector<real_t> tab(((size_t) FIELDS) * loc.sizeL());
+		if (loc.size() > 0) {
+			Interpolate(loc, shell_want[b][mpi.rank], shell_old[b].data(), shell_new[b].data(), t, tab.data());
+			Rescale(tab.data(), loc.sizeL(), alpha_cf);
+		}
+		lattice->SetFields(ring_boxes[b], tab.data(), b + 1 == ring_boxes.size());
+	}
+}
+
+/// Average the interior of the fine Lattice and set it in the parent
+void RefinePatch::Restrict()
+{
+	lbRegion own = restrict_have[mpi.rank];
+	lbRegion fine = Children(own);
+	size_t nc = own.sizeL(), nf = fine.sizeL();
+	std::vector<real_t> ftab(((size_t) FIELDS) * nf), ctab(((size_t) FIELDS) * nc, 0);
+	if (nc > 0) {
+		lattice->GetFields(fine, ftab.data());
+		double div = 1.0 / (ratio[0] * ratio[1] * ratio[2]);
+		for (int z=fine.dz; z<fine.dz+fine.nz; z++)
+		for (int y=fine.dy; y<fine.dy+fine.ny; y++)
+		for (int x=fine.dx; x<fine.dx+fine.nx; x++) {
+			size_t i = fine.offsetL(x,y,z);
+			size_t o = own.offsetL(patch.dx + x / ratio[0], patch.dy + y / ratio[1], patch.dz + z / ratio[2]);
+			for (int f=0; f<FIELDS; f++) ctab[o + f*nc] += div * ftab[i + f*nf];
+		}
+		Rescale(ctab.data(), nc, alpha_fc);
+	}
+	std::vector<real_t> tab(((size_t) FIELDS) * restrict_want[mpi.rank].sizeL());
+	real_t * src = ctab.data();
+	ExchangeBoxes<real_t>(restrict_have, restrict_want, FIELDS, [own, src](lbRegion r, real_t * buf) { CopyBox(own, src, r, buf, FIELDS); }, tab.data());
+	parent->SetFields(restricted, tab.data());
+}
+
+/// Create and initialize the fine Lattice (has to be called on all processors)
+/**
+  \param units Units of the case (for scaling of the Settings)
+  \param xsdim X thread division (the fine X size has to be a multiple of it)
+  \param nu_name Name of the viscosity setting
+  \param group_name Group of the rescaled densities
+  \return 0 on success, -1 on error
+*/
+int RefinePatch::Init(UnitEnv& units, int xsdim, const std::string& nu_name, const std::string& group_name)
+{
+	lbRegion total = parent->mpi.totalregion;
+	int pd[3] = { patch.dx, patch.dy, patch.dz }, pn[3] = { patch.nx, patch.ny, patch.nz }, tn[3] = { total.nx, total.ny, total.nz };
+	int fn[3], rn[3], wc[3];
+	for (int k=0; k<3; k++) {
+		ratio[k] = tn[k] > 1 ? 2 : 1;
+		if ((pn[k] < 1) || (pd[k] < 0) || (pd[k] + pn[k] > tn[k])) {
+			ERROR("Refinement patch %dx%dx%d+%d,%d,%d is not inside of the lattice\n", patch.nx, patch.ny, patch.nz, patch.dx, patch.dy, patch.dz);
+			return -1;
+		}
+		if ((ratio[k] != 1) && ((pd[k] < 1) || (pd[k] + pn[k] > tn[k] - 1))) {
+			ERROR("Refinement patch has to be at least one node from the edges of the lattice\n");
+			return -1;
+		}
+		fn[k] = pn[k] * ratio[k];
+		wc[k] = ratio[k] != 1 ? (ring + 1) / 2 : 0;
+		rn[k] = pn[k] - 2*wc[k];
+		if (rn[k] < 1) {
+			ERROR("Refinement patch is too small for a ring of %d nodes\n", ring);
+			return -1;
+		}
+	}
+	{
+		int reach = 0;
+		for (const Model::Density& d : parent->model->densities) reach = std::max(reach, std::max(abs(d.dx), std::max(abs(d.dy), abs(d.dz))));
+		if (ring < reach) {
+			ERROR("Ring of the refinement patch (%d) has to be at least the reach of the streaming (%d)\n", ring, reach);
+			return -1;
+		}
+	}
+	if (fn[0] % xsdim != 0) {
+		ERROR("X size of the refinement patch (%d) times %d has to be a multiple of %d\n", pn[0], ratio[0], xsdim);
+		return -1;
+	}
+	restricted = lbRegion(pd[0] + wc[0], pd[1] + wc[1], pd[2] + wc[2], rn[0], rn[1], rn[2]);
+
+	// Densities rescaled between the levels
+	for (const Model::Density& d : parent->model->densities) if (d.group == group_name) {
+		group.push_back(d.fieldId);
+		cx.push_back(d.dx);
+		cy.push_back(d.dy);
+		cz.push_back(d.dz);
+	}
+	if (group.size() == 0) {
+		ERROR("No densities in group %s (set the group attribute of Refine)\n", group_name.c_str());
+		return -1;
+	}
+	{
+		int dim = 0;
+		for (size_t k=0; k<group.size(); k++) if (cx[k] != 0) { dim++; break; }
+		for (size_t k=0; k<group.size(); k++) if (cy[k] != 0) { dim++; break; }
+		for (size_t k=0; k<group.size(); k++) if (cz[k] != 0) { dim++; break; }
+		double sum = 0;
+		for (size_t k=0; k<group.size(); k++) {
+			w.push_back(LatticeWeight(dim, group.size(), cx[k]*cx[k] + cy[k]*cy[k] + cz[k]*cz[k]));
+			if (w[k] == 0) sum = -1;
+			if (sum >= 0) sum += w[k];
+		}
+		if (fabs(sum - 1) > 1e-10) {
+			ERROR("Densities of group %s are not a D2Q9, D3Q15, D3Q19 or D3Q27 velocity set\n", group_name.c_str());
+			return -1;
+		}
+	}
+	const Model::Setting& nu = parent->model->settings.by_name(nu_name);
+	if (! nu) {
+		ERROR("No setting %s (set the nu attribute of Refine)\n", nu_name.c_str());
+		return -1;
+	}
+	nu_id = nu.id;
+
+	// Scale of the Settings: dx, dt are halved and the mass scales with dx^3
+	scale.assign(SETTINGS, 1);
+	for (const Model::Setting& set : parent->model->settings) {
+		if (set.isDerived) scale[set.derivedSetting] = 0;
+	}
+	for (const Model::Setting& set : parent->model->settings) if (scale[set.id] != 0) {
+		try {
+			UnitVal u = units.readUnit(set.unit);
+			scale[set.id] = pow(2.0, u.uni[0] + u.uni[1] + 3*u.uni[2]);
+		} catch (std::string & err) {
+			ERROR("Cannot read the unit of %s: %s\n", set.name.c_str(), err.c_str());
+			return -1;
+		}
+		if (set.isDerived) {
+			const Model::Setting& der = parent->model->settings.by_id(set.derivedSetting);
+			double val = set.derivedValue(parent->settings[set.id]);
+			if (fabs(val - parent->settings[der.id]) > 1e-10 * (fabs(val) + 1e-10)) {
+				warning("%s is not derived from %s in the parent. The refinement patch uses %s\n", der.name.c_str(), set.name.c_str(), set.name.c_str());
+			}
+		}
+	}
+
+	// Decomposition of the fine Lattice (aligned to the coarse nodes)
+	lbRegion fine(0, 0, 0, fn[0], fn[1], fn[2]);
+	mpi = parent->mpi;
+	nodes.resize(mpi.size);
+	for (int i=0; i<mpi.size; i++) nodes[i].rank = i;
+	mpi.node = nodes.data();
+	mpi.totalregion = fine;
+	int unit[3] = { xsdim, ratio[1], ratio[2] };
+	if (unit[0] % ratio[0] != 0) unit[0] *= ratio[0];
+	if (MPIDivide(fine, unit, mpi)) return -1;
+
+	lattice = new Lattice(nodes[mpi.rank].region, mpi, 2);
+	lattice->Callback(NULL, NULL);
+	lattice->setPosition(ratio[0] * (parent->px + pd[0]), ratio[1] * (parent->py + pd[1]), ratio[2] * (parent->pz + pd[2]));
+	lbRegion reg = lattice->region;
+
+	// Geometry: the flags of the parent nodes
+	{
+		std::vector<lbRegion> have(mpi.size), want(mpi.size);
+		for (int i=0; i<mpi.size; i++) {
+			have[i] = parent->mpi.node[i].region;
+			want[i] = Parents(nodes[i].region);
+		}
+		lbRegion box = want[mpi.rank];
+		std::vector<flag_t> cflags(box.sizeL()), flags(reg.sizeL());
+		Lattice * lat = parent;
+		ExchangeBoxes<flag_t>(have, want, 1, [lat](lbRegion r, flag_t * buf) { lat->GetFlags(r, buf); }, cflags.data());
+		for (int z=reg.dz; z<reg.dz+reg.nz; z++)
+		for (int y=reg.dy; y<reg.dy+reg.ny; y++)
+		for (int x=reg.dx; x<reg.dx+reg.nx; x++)
+			flags[reg.offsetL(x,y,z)] = cflags[box.offsetL(pd[0] + x / ratio[0], pd[1] + y / ratio[1], pd[2] + z / ratio[2])];
+		lattice->FlagOverwrite(flags.data(), reg);
+	}
+	lattice->zSet.copy(parent->zSet);
+	synced.assign(SETTINGS, NAN);
+	SyncSettings();
+
+	// Ring: slabs in X, then in Y (without the X slabs), then in Z (without both)
+	{
+		int lo[3] = { 0, 0, 0 }, hi[3] = { fn[0], fn[1], fn[2] };
+		for (int k=0; k<3; k++) if (ratio[k] != 1) {
+			for (int side=0; side<2; side++) {
+				int d[3], n[3];
+				for (int l=0; l<3; l++) {
+					d[l] = lo[l];
+					n[l] = hi[l] - lo[l];
+				}
+				d[k] = side ? fn[k] - ring : 0;
+				n[k] = ring;
+				ring_boxes.push_back(lbRegion(d[0], d[1], d[2], n[0], n[1], n[2]));
+			}
+			lo[k] = ring;
+			hi[k] = fn[k] - ring;
+		}
+	}
+	shell_want.resize(ring_boxes.size());
+	shell_old.resize(ring_boxes.size());
+	shell_new.resize(ring_boxes.size());
+	for (size_t b=0; b<ring_boxes.size(); b++) {
+		shell_want[b].resize(mpi.size);
+		for (int i=0; i<mpi.size; i++) shell_want[b][i] = Stencil(nodes[i].region.intersect(ring_boxes[b]));
+	}
+	restrict_have.resize(mpi.size);
+	restrict_want.resize(mpi.size);
+	for (int i=0; i<mpi.size; i++) {
+		lbRegion own(pd[0] + nodes[i].region.dx / ratio[0], pd[1] + nodes[i].region.dy / ratio[1], pd[2] + nodes[i].region.dz / ratio[2],
+			nodes[i].region.nx / ratio[0], nodes[i].region.ny / ratio[1], nodes[i].region.nz / ratio[2]);
+		restrict_have[i] = own.intersect(restricted);
+		restrict_want[i] = parent->mpi.node[i].region.intersect(restricted);
+	}
+
+	// Initial state: interpolated from the parent
+	lattice->Init();
+	{
+		std::vector<lbRegion> want(mpi.size);
+		for (int i=0; i<mpi.size; i++) want[i] = Stencil(nodes[i].region);
+		std::vector<real_t> ctab, tab(((size_t) FIELDS) * reg.sizeL());
+		GatherParent(want, ctab);
+		Interpolate(reg, want[mpi.rank], ctab.data(), NULL, 0, tab.data());
+		Rescale(tab.data(), reg.sizeL(), alpha_cf);
+		lattice->SetFields(tab.data());
+	}
+	return 0;
+}
+
+/// Gather the coarse Fields under the ring before the iteration of the parent (time t)
+void RefinePatch::Before()
+{
+	SyncSettings();
+	for (size_t b=0; b<ring_boxes.size(); b++) GatherParent(shell_want[b], shell_old[b]);
+}
+
+/// Make two iterations of the fine Lattice after the iteration of the parent, and restrict it to the parent
+void RefinePatch::After()
+{
+	for (size_t b=0; b<ring_boxes.size(); b++) GatherParent(shell_want[b], shell_new[b]);
+	SetRing(0);
+	lattice->Iterate(1, ITER_NORM);
+	SetRing(0.5);
+	lattice->Iterate(1, ITER_NORM);
+	Restrict();
+}
@@ -0,0 +1,70 @@
+#ifndef REFINEMENT_H
+#define REFINEMENT_H
+
+#include <mpi.h>
+#include "Consts.h"
+#include "Global.h"
+#include "cross.h"
+#include "types.h"
+#include "unit.h"
+#include <vector>
+#include <string>
+
+class Lattice;
+
+/// Patch of a block-structured refinement
+/**
+  A box of the parent Lattice covered by a separate (fine) Lattice with twice
+  the resolution in space and time (in the directions in which the parent is not flat).
+  The fine Lattice is decomposed over all the processors, like the parent.
+  For every iteration of the parent (see Lattice::IterationRefined):
+  - Before: the coarse Fields under the ring of the patch are gathered (time t),
+  - After: they are gathered again (time t+1), and the fine Lattice makes two
+    iterations, with the outer ring of fine nodes set by interpolation in space
+    (tri-linear) and time (at t and t+1/2). The interior of the patch is then
+    restricted (averaged) back to the parent.
+
+  The densities of the rescaled group are split into the equilibrium and
+  non-equilibrium parts. The Fields are stored after collision, so the
+  non-equilibrium part is rescaled by (tau_f - 1)/(2 (tau_c - 1)) from coarse
+  to fine, and by its inverse from fine to coarse (tau = 3 nu + 1/2).
+*/
+class RefinePatch {
+	Lattice * parent; ///< Coarse Lattice
+	lbRegion patch; ///< Refined box (in the parent nodes)
+	int ring; ///< Width of the outer ring of fine nodes set from the parent
+	std::vector<NodeInfo> nodes; ///< Decomposition of the fine Lattice
+	MPIInfo mpi; ///< MPI information of the fine Lattice
+	std::vector<double> scale; ///< Scale of the Settings from the parent to the fine Lattice (0 for the derived ones)
+	std::vector<real_t> synced; ///< Settings of the parent last copied to the fine Lattice
+	std::vector<int> group; ///< Fields of the rescaled densities
+	std::vector<int> cx, cy, cz; ///< Velocities of the rescaled densities
+	std::vector<double> w; ///< Weights of the rescaled densities
+	int nu_id; ///< Viscosity setting
+	double alpha_cf, alpha_fc; ///< Scale of the non-equilibrium part (coarse to fine and fine to coarse)
+	std::vector<lbRegion> ring_boxes; ///< Boxes of the ring (in the fine nodes)
+	std::vector< std::vector<lbRegion> > shell_want; ///< Coarse boxes wanted by the processors for each of the ring boxes
+	std::vector< std::vector<real_t> > shell_old, shell_new; ///< Coarse Fields under the ring at t and t+1
+	lbRegion restricted; ///< Coarse box set from the fine Lattice
+	std::vector<lbRegion> restrict_have, restrict_want; ///< Coarse boxes averaged and set by the processors
+	double Position(int k, int i);
+	lbRegion Stencil(lbRegion fine);
+	lbRegion Parents(lbRegion fine);
+	lbRegion Children(lbRegion coarse);
+	void GatherParent(const std::vector<lbRegion>& want, std::vector<real_t>& tab);
+	void Interpolate(lbRegion fine, lbRegion box, const real_t * a, const real_t * b, double t, real_t * tab);
+	void Rescale(real_t * tab, size_t n, double alpha);
+	void SyncSettings();
+	void SetRing(double t);
+	void Restrict();
+public:
+	Lattice * lattice; ///< Fine Lattice
+	int ratio[3]; ///< Refinement ratio in X, Y and Z (2, or 1 in the flat directions of the parent)
+	RefinePatch(Lattice * parent_, lbRegion patch_, int ring_);
+	~RefinePatch();
+	int Init(UnitEnv& units, int xsdim, const std::string& nu_name, const std::string& group_name);
+	void Before();
+	void After();
+};
+
+#endif
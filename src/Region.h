@@ -25,6 +25,22 @@ public:
     if (ret.nx <= 0 || ret.ny <= 0 || ret.nz <= 0) { ret.nx = ret.ny = ret.nz = 0; };
     return ret;
   };
+  /// Boxes of stride^3 nodes (tiling over from its corner) starting in this region (or touching it), in box coordinates
+  inline lbRegion coarse(lbRegion over, int stride, bool touching = false) {
+    lbRegion f = intersect(over);
+    lbRegion ret(0,0,0,0,0,0);
+    if (f.nx <= 0 || f.ny <= 0 || f.nz <= 0) return ret;
+    coarse_range(f.dx, f.nx, over.dx, stride, touching, ret.dx, ret.nx);
+    coarse_range(f.dy, f.ny, over.dy, stride, touching, ret.dy, ret.ny);
+    coarse_range(f.dz, f.nz, over.dz, stride, touching, ret.dz, ret.nz);
+    if (ret.nx <= 0 || ret.ny <= 0 || ret.nz <= 0) { ret.nx = ret.ny = ret.nz = 0; };
+    return ret;
+  };
+  static inline void coarse_range(int d, int n, int od, int stride, bool touching, int& cd, int& cn) {
+    int lo = d - od, hi = d + n - 1 - od;
+    cd = touching ? lo / stride : (lo + stride - 1) / stride;
+    cn = hi / stride - cd + 1;
+  };
   inline int offset(int x,int y) {
     return (x-dx) + (y-dy) * nx;
   };
@@ -4,4 +4,5 @@
 
 namespace rfi {
     template class RemoteForceInterface< ForceCalculator, RotParticle, ArrayOfStructures, real_t, pinned_allocator<real_t> >;
+    template class RemoteForceInterface< ForceIntegrator, RotParticle, ArrayOfStructures, real_t, pinned_allocator<real_t> >;
 };
\ No newline at end of file
@@ -47,6 +47,18 @@ enum rfi_storage_t {
   StructureOfArrays
 };
 
+/// Integrator running in the same process as the force calculator
+/**
+  Called in-loop by the calculator (see RemoteForceInterface::ConnectLocal):
+  Particles() when the calculator needs the particles, and Forces() when
+  it has the forces ready.
+*/
+class LocalIntegrator {
+public:
+  virtual void Particles() = 0; ///< Set the sizes, Alloc and fill the particle data
+  virtual void Forces() = 0; ///< Read the forces and move the particles
+  virtual ~LocalIntegrator() {}
+};
 
 template < rfi_type_t TYPE, rfi_rot_t ROT, rfi_storage_t STORAGE = ArrayOfStructures, typename rfi_real_t = double, typename tab_allocator = std::allocator<rfi_real_t> >
 class RemoteForceInterface {
@@ -56,7 +68,15 @@ public:
     rfi_real_t lower[3];
     rfi_real_t upper[3];
   };
+  /// Type of the other side of the connection
+  typedef RemoteForceInterface< TYPE == ForceCalculator ? ForceIntegrator : ForceCalculator, ROT, STORAGE, rfi_real_t, tab_allocator > partner_t;
 private:
+  template < rfi_type_t, rfi_rot_t, rfi_storage_t, typename, typename > friend class RemoteForceInterface;
+  partner_t* local_partner; ///< Other side of an in-process connection
+  LocalIntegrator* local_integrator; ///< Integrator called in-loop (calculator side of an in-process connection)
+  void LocalConnect(MPI_Comm comm_, partner_t& partner);
+  void LocalSwap();
+  void SetupUnits(int my_ccwu, int other_ccwu, const std::vector< rfi_real_t >& other_units);
   int world_size; ///< Size of current program world
   int universe_size; ///< Size of the universe (both integrated programs)
   int rank; ///< My rank in world
@@ -124,6 +144,8 @@ public:
   ~RemoteForceInterface();
   void MakeTypes(bool,bool);  
   int Connect(MPI_Comm comm_, MPI_Comm intercomm_);
+  int ConnectLocal(MPI_Comm comm_, partner_t& partner, LocalIntegrator* integrator);
+  inline bool Local() { return local_partner != NULL; }
   void Alloc();  
   inline const size_t size() const { return totsize; }
   inline const size_t mem_size() const { return ntab * sizeof(rfi_real_t); }
@@ -85,6 +85,8 @@ RemoteForceInterface < TYPE, ROT, STORAGE, rfi_real_t, tab_allocator >::RemoteFo
    workers = 0;
    masters = 0;
    intercomm = MPI_COMM_NULL;
+   local_partner = NULL;
+   local_integrator = NULL;
    totsize = 0;
    ntab = 0;
    connected = false;
@@ -273,6 +275,43 @@ void RemoteForceInterface < TYPE, ROT, STORAGE, rfi_real_t, tab_allocator >::Mak
 }
 
 
+template < rfi_type_t TYPE, rfi_rot_t ROT, rfi_storage_t STORAGE, typename rfi_real_t, typename tab_allocator >
+void RemoteForceInterface < TYPE, ROT, STORAGE, rfi_real_t, tab_allocator >::SetupUnits(int my_ccwu, int other_ccwu, const std::vector< rfi_real_t >& other_units) {
+    if (my_ccwu && other_ccwu) {
+      if (TYPE == ForceCalculator) {
+        other_ccwu = false;
+      } else {
+        my_ccwu = false;
+      }
+    }
+    if (my_ccwu) {
+      output("RFI: %s: I'm taking care of the units\n",name.c_str());
+    } else if (other_ccwu) {
+      // The other side is taking care of the units
+    } else {
+      ERROR("RFI: Nobody is taking care of the units!\n");
+      exit(-1);
+    }
+    double meter, second, kilogram;
+    unit.resize(particle_size);
+    if (my_ccwu) {
+      meter = other_units[0]/base_units[0];
+      second = other_units[1]/base_units[1];
+      kilogram = other_units[2]/base_units[2];
+      output("RFI: %s: Unit conversion: m:%lg, s:%lg, kg:%lg\n",name.c_str(), meter, second, kilogram);
+      unit[RFI_DATA_R] = meter;
+//      unit[RFI_DATA_VOL] = meter*meter*meter;
+      for (int i=0;i<3;i++) {
+        unit[RFI_DATA_POS+i] = meter;
+        unit[RFI_DATA_VEL+i] = meter/second;
+        unit[RFI_DATA_ANGVEL+i] = 1.0/second;
+        unit[RFI_DATA_FORCE+i] = kilogram*meter/(second*second);
+        unit[RFI_DATA_MOMENT+i] = kilogram*meter*meter/(second*second);
+      }
+      auto_timestep = 1.0/second;
+    }
+}
+
 template < rfi_type_t TYPE, rfi_rot_t ROT, rfi_storage_t STORAGE, typename rfi_real_t, typename tab_allocator >
 int RemoteForceInterface < TYPE, ROT, STORAGE, rfi_real_t, tab_allocator >::Negotiate() {
   if (! connected) return -1;
@@ -338,42 +377,10 @@ int RemoteForceInterface < TYPE, ROT, STORAGE, rfi_real_t, tab_allocator >::Nego
     output("RFI: %s: Non trivial units\n",name.c_str());
     int my_ccwu = can_cope_with_units;
     int other_ccwu = Exchange(my_ccwu);
-    if (my_ccwu && other_ccwu) {
-      if (TYPE == ForceCalculator) {
-        other_ccwu = false;
-      } else {
-        my_ccwu = false;
-      }
-    }
-    if (my_ccwu) {
-      output("RFI: %s: I'm taking care of the units\n",name.c_str());
-    } else if (other_ccwu) {
-      // The other side is taking care of the units
-    } else {
-      ERROR("RFI: Nobody is taking care of the units!\n");
-      exit(-1);
-    }
     std::vector< rfi_real_t > my_units, other_units;
     for (int i=0;i<3;i++) my_units.push_back(base_units[i]);
     other_units = Exchange(my_units);
-    double meter, second, kilogram;
-    unit.resize(particle_size);
-    if (my_ccwu) {
-      meter = other_units[0]/my_units[0];
-      second = other_units[1]/my_units[1];
-      kilogram = other_units[2]/my_units[2];
-      output("RFI: %s: Unit conversion: m:%lg, s:%lg, kg:%lg\n",name.c_str(), meter, second, kilogram);
-      unit[RFI_DATA_R] = meter;
-//      unit[RFI_DATA_VOL] = meter*meter*meter;
-      for (int i=0;i<3;i++) {
-        unit[RFI_DATA_POS+i] = meter;
-        unit[RFI_DATA_VEL+i] = meter/second;
-        unit[RFI_DATA_ANGVEL+i] = 1.0/second;
-        unit[RFI_DATA_FORCE+i] = kilogram*meter/(second*second);
-        unit[RFI_DATA_MOMENT+i] = kilogram*meter*meter/(second*second);
-      }
-      auto_timestep = 1.0/second;
-    }
+    SetupUnits(my_ccwu, other_ccwu, other_units);
 
     typedef std::vector<std::string::value_type> vars_pack_t;
     vars_pack_t my_vars, other_vars;
@@ -491,6 +498,80 @@ int RemoteForceInterface < TYPE, ROT, STORAGE, rfi_real_t, tab_allocator >::Conn
    return 0;
 }
 
+/// Connect to an integrator running in the same process
+/**
+  No MPI communication is made between the sides: the integrator is called
+  in-loop (in SendSizes and SendForces) and the particle tables are swapped
+  between the sides, instead of being sent. Every rank of comm_ has its own
+  integrator, with the box of this rank as its only worker.
+*/
+template < rfi_type_t TYPE, rfi_rot_t ROT, rfi_storage_t STORAGE, typename rfi_real_t, typename tab_allocator >
+int RemoteForceInterface < TYPE, ROT, STORAGE, rfi_real_t, tab_allocator >::ConnectLocal(MPI_Comm comm_, partner_t& partner, LocalIntegrator* integrator) {
+   if (connected || partner.connected) {
+     ERROR("RFI: Already connected");
+     return -1;
+   }
+   if (TYPE != ForceCalculator) {
+     ERROR("RFI: In-process connection has to be made by the force calculator");
+     return -1;
+   }
+   LocalConnect(comm_, partner);
+   partner.LocalConnect(comm_, *this);
+   local_integrator = integrator;
+   if (non_trivial_units || partner.non_trivial_units) {
+     std::vector< rfi_real_t > my_units(base_units, base_units + 3);
+     std::vector< rfi_real_t > other_units(partner.base_units, partner.base_units + 3);
+     SetupUnits(can_cope_with_units, partner.can_cope_with_units, other_units);
+     partner.SetupUnits(partner.can_cope_with_units, can_cope_with_units, my_units);
+   }
+   vars_t my_vars = vars;
+   for (typename vars_t::const_iterator it = partner.vars.begin(); it != partner.vars.end(); it++) vars[it->first] = it->second;
+   for (typename vars_t::const_iterator it = my_vars.begin(); it != my_vars.end(); it++) partner.vars[it->first] = it->second;
+   output("RFI: %s: Connected in-process to %s\n", name.c_str(), partner.name.c_str());
+   return 0;
+}
+
+template < rfi_type_t TYPE, rfi_rot_t ROT, rfi_storage_t STORAGE, typename rfi_real_t, typename tab_allocator >
+void RemoteForceInterface < TYPE, ROT, STORAGE, rfi_real_t, tab_allocator >::LocalConnect(MPI_Comm comm_, partner_t& partner) {
+   comm = comm_;
+   MPI_Comm_rank(comm, &rank);
+   workers = 1;
+   masters = 1;
+   sizes.resize(workers, 0);
+   offsets.resize(workers+1, 0);
+   connected = true;
+   active = true;
+   Zero();
+   rot = ROT == RotParticle;
+   particle_size = RFI_DATA_SIZE;
+   unit.resize(particle_size);
+   for (int i=0;i<RFI_DATA_SIZE; i++) unit[i] = 1.0;
+   int si;
+   MPI_Type_size(MPI_RFI_REAL_T, &si);
+   real_size = si;
+   MPI_PARTICLE = NULL;
+   MPI_FORCES = NULL;
+   MakeTypes(true,true);
+   workerBoxes.resize(1);
+   workerBoxes[0].declared = partner.myBox.declared;
+   for (int i=0; i<3; i++) {
+     workerBoxes[0].lower[i] = partner.myBox.lower[i];
+     workerBoxes[0].upper[i] = partner.myBox.upper[i];
+   }
+   local_partner = &partner;
+}
+
+/// Take over the particle table of the other side (without copying the data)
+template < rfi_type_t TYPE, rfi_rot_t ROT, rfi_storage_t STORAGE, typename rfi_real_t, typename tab_allocator >
+void RemoteForceInterface < TYPE, ROT, STORAGE, rfi_real_t, tab_allocator >::LocalSwap() {
+  sizes[0] = local_partner->sizes[0];
+  offsets[0] = 0;
+  offsets[1] = sizes[0];
+  totsize = local_partner->totsize;
+  ntab = local_partner->ntab;
+  tab.swap(local_partner->tab);
+}
+
 template < rfi_type_t TYPE, rfi_rot_t ROT, rfi_storage_t STORAGE, typename rfi_real_t, typename tab_allocator >
 void RemoteForceInterface < TYPE, ROT, STORAGE, rfi_real_t, tab_allocator >::ExchangeBoxes() {
   std::vector< MPI_Request > reqs;
@@ -530,6 +611,17 @@ void RemoteForceInterface < TYPE, ROT, STORAGE, rfi_real_t, tab_allocator >::Zer
 template < rfi_type_t TYPE, rfi_rot_t ROT, rfi_storage_t STORAGE, typename rfi_real_t, typename tab_allocator >
 void RemoteForceInterface < TYPE, ROT, STORAGE, rfi_real_t, tab_allocator >::Close() {
   if (! Active()) return;
+  if (Local()) {
+    partner_t* partner = local_partner;
+    Zero();
+    connected = false;
+    active = false;
+    local_partner = NULL;
+    local_integrator = NULL;
+    output("RFI: %s: Closed.\n", name.c_str());
+    partner->Close();
+    return;
+  }
   debug1("RFI: %s: Sending the order to kill ...\n", name.c_str());
   MPI_Request req;
   MPI_Isend(&kill_flag, 1, MPI_INT, 0, 0xD2, comm, &req); // kill root
@@ -626,6 +718,13 @@ void RemoteForceInterface < TYPE, ROT, STORAGE, rfi_real_t, tab_allocator >::WSe
 template < rfi_type_t TYPE, rfi_rot_t ROT, rfi_storage_t STORAGE, typename rfi_real_t, typename tab_allocator >
 void RemoteForceInterface < TYPE, ROT, STORAGE, rfi_real_t, tab_allocator >::SendSizes() {
   if (! Active()) return;
+  if (Local()) {
+    if (local_integrator != NULL) {
+      local_integrator->Particles();
+      LocalSwap();
+    }
+    return;
+  }
   debug1("RFI: %s: SendSizes {\n", name.c_str());
   if (TYPE == ForceCalculator) {
     WSendForces();
@@ -669,6 +768,13 @@ void RemoteForceInterface < TYPE, ROT, STORAGE, rfi_real_t, tab_allocator >::WSe
 template < rfi_type_t TYPE, rfi_rot_t ROT, rfi_storage_t STORAGE, typename rfi_real_t, typename tab_allocator >
 void RemoteForceInterface < TYPE, ROT, STORAGE, rfi_real_t, tab_allocator >::SendForces() {
     if (! Active()) return;
+    if (Local()) {
+      if (local_integrator != NULL) {
+        LocalSwap();
+        local_integrator->Forces();
+      }
+      return;
+    }
     debug1("RFI: %s: SendForces {\n", name.c_str());
     if (TYPE == ForceCalculator) {
         ISendForces();
@@ -712,6 +818,7 @@ void RemoteForceInterface < TYPE, ROT, STORAGE, rfi_real_t, tab_allocator >::WSe
 template < rfi_type_t TYPE, rfi_rot_t ROT, rfi_storage_t STORAGE, typename rfi_real_t, typename tab_allocator >
 void RemoteForceInterface < TYPE, ROT, STORAGE, rfi_real_t, tab_allocator >::SendParticles() {
     if (! Active()) return;
+    if (Local()) return;
     debug1("RFI: %s: SendParticles {\n", name.c_str());
     if (TYPE == ForceCalculator) {
       WSendParticles();
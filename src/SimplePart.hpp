@@ -0,0 +1,692 @@
+#ifndef SIMPLEPART_HPP
+#define SIMPLEPART_HPP
+
+#include "RemoteForceInterface.h"
+#include "pugixml.hpp"
+#include <mpi.h>
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+namespace simplepart {
+
+const double twopi = 8*atan(1.0);
+const double pi = 4*atan(1.0);
+
+struct Particle {
+  double x[3];
+  double r;
+  double m;
+  double v[3];
+  double v0[3];
+  double f[3];
+  double favg[3];
+  double omega[3];
+  double omega0[3];
+  double torque[3];
+  double ease_in_time;
+  size_t n;
+  bool logging;
+  size_t log_index;
+  Particle() {
+    n = 0;
+    log_index = 0;
+    for (int i=0; i<3; i++) {
+      x[i] = 0;
+      v[i] = 0;
+      v0[i] = 0;
+      f[i] = 0;
+      favg[i] = 0;
+      omega[i] = 0;
+      omega0[i] = 0;
+      torque[i] = 0;
+    }
+    m = 0;
+    r = 0;
+    logging = false;
+    ease_in_time = 0;
+  }
+};
+
+struct attr_name_t {
+  std::string vector;
+  std::string non_vector;
+  int d;
+  attr_name_t(const std::string& name) {
+    bool vec = true;
+    d = -1;
+    auto w = name.back();
+    if (w == 'x') { d = 0; }
+    else if (w == 'y') { d = 1; }
+    else if (w == 'z') { d = 2; }
+    else { vec = false; }
+    if (vec) {
+      vector = name;
+      vector.pop_back();
+      non_vector = "=";
+    } else {
+      non_vector = name;
+      vector = "=";
+    }
+  }
+  attr_name_t(const char* name) : attr_name_t(std::string(name)) {};
+  bool operator==(const std::string& name) {
+    return non_vector == name;
+  }
+};
+
+typedef std::vector<Particle> Particles;
+
+/// Copy of a particle (or of its periodic image) sent to a worker
+struct Image {
+  size_t p; ///< Index of the particle
+  int worker; ///< Worker to which the copy is sent
+  int d[3]; ///< Periodic shift of the copy
+  size_t i; ///< Index of the copy in the RFI buffer
+};
+
+/// Coarse cell grid of the worker boxes
+/**
+  Every cell stores the list of workers which boxes overlap it,
+  so that finding the workers touched by a particle costs only
+  a few cells, instead of a loop over all the workers.
+*/
+struct WorkerBins {
+  int workers;
+  std::vector<double> lower, upper; ///< Boxes of the workers (3 values per worker)
+  std::vector<int> clower, cupper; ///< Range of cells overlapped by the box of each worker
+  double L[3], U[3]; ///< Bounds of all the boxes
+  double h[3]; ///< Size of a cell
+  int n[3]; ///< Number of cells in each direction
+  std::vector<size_t> cell_start; ///< Start of the list of workers of each cell
+  std::vector<int> cell_workers; ///< Workers overlapping each cell
+
+  inline int Cell(int j, double x) const {
+    int c = floor((x - L[j]) / h[j]);
+    if (c < 0) c = 0;
+    if (c >= n[j]) c = n[j] - 1;
+    return c;
+  }
+
+  template <class RFI_t> void Build(RFI_t& RFI, const double* periodicity) {
+    workers = RFI.Workers();
+    lower.resize(3*workers);
+    upper.resize(3*workers);
+    clower.resize(3*workers);
+    cupper.resize(3*workers);
+    for (int j = 0; j < 3; j++) {
+      L[j] = 0;
+      U[j] = 0;
+    }
+    for (int w = 0; w < workers; w++) {
+      for (int j = 0; j < 3; j++) {
+        double lo = 0;
+        double up = periodicity[j];
+        if (RFI.WorkerBox(w).declared) {
+          lo = RFI.WorkerBox(w).lower[j];
+          up = RFI.WorkerBox(w).upper[j];
+        }
+        lower[3*w+j] = lo;
+        upper[3*w+j] = up;
+        if (w == 0 || lo < L[j]) L[j] = lo;
+        if (w == 0 || up > U[j]) U[j] = up;
+      }
+    }
+    // Cells of roughly the size of an average worker box
+    double vol = 1;
+    int dims = 0;
+    for (int j = 0; j < 3; j++) if (U[j] > L[j]) {
+      vol *= U[j] - L[j];
+      dims++;
+    }
+    double side = 0;
+    if (dims > 0 && workers > 0) side = pow(vol / workers, 1.0 / dims);
+    size_t ncells = 1;
+    for (int j = 0; j < 3; j++) {
+      n[j] = 1;
+      h[j] = 1;
+      if (U[j] > L[j]) {
+        if (side > 0) n[j] = std::min(1024.0, std::max(1.0, ceil((U[j] - L[j]) / side)));
+        h[j] = (U[j] - L[j]) / n[j];
+      }
+      ncells *= n[j];
+    }
+    cell_start.assign(ncells + 1, 0);
+    for (int pass = 0; pass < 2; pass++) {
+      if (pass == 1) {
+        for (size_t c = 0; c < ncells; c++) cell_start[c+1] += cell_start[c];
+        cell_workers.resize(cell_start[ncells]);
+      }
+      std::vector<size_t> fill(cell_start.begin(), cell_start.end() - 1);
+      for (int w = 0; w < workers; w++) {
+        int* lo = &clower[3*w];
+        int* up = &cupper[3*w];
+        for (int j = 0; j < 3; j++) {
+          lo[j] = Cell(j, lower[3*w+j]);
+          up[j] = Cell(j, upper[3*w+j]);
+        }
+        for (int x = lo[0]; x <= up[0]; x++)
+          for (int y = lo[1]; y <= up[1]; y++)
+            for (int z = lo[2]; z <= up[2]; z++) {
+              size_t c = x + n[0]*(y + n[1]*z);
+              if (pass == 0) {
+                cell_start[c+1]++;
+              } else {
+                cell_workers[fill[c]++] = w;
+              }
+            }
+      }
+    }
+    output("SIMPLEPART: Binned %d worker boxes in %dx%dx%d cells\n", workers, n[0], n[1], n[2]);
+  }
+
+  /// Calls fun(worker) for every worker which box is touched by the ball (x,r)
+  template <class F> void Touching(const double* x, double r, F fun) const {
+    int lo[3], up[3];
+    for (int j = 0; j < 3; j++) {
+      if (x[j] + r < L[j] || x[j] - r > U[j]) return;
+      lo[j] = Cell(j, x[j] - r);
+      up[j] = Cell(j, x[j] + r);
+    }
+    int c[3];
+    for (c[0] = lo[0]; c[0] <= up[0]; c[0]++)
+      for (c[1] = lo[1]; c[1] <= up[1]; c[1]++)
+        for (c[2] = lo[2]; c[2] <= up[2]; c[2]++) {
+          size_t k = c[0] + n[0]*(c[1] + n[1]*c[2]);
+          for (size_t i = cell_start[k]; i < cell_start[k+1]; i++) {
+            int w = cell_workers[i];
+            bool first = true; // report the worker only in the first common cell
+            bool touch = true;
+            for (int j = 0; j < 3; j++) {
+              if (c[j] != std::max(lo[j], clower[3*w+j])) first = false;
+              if (x[j] + r < lower[3*w+j] || x[j] - r > upper[3*w+j]) touch = false;
+            }
+            if (first && touch) fun(w);
+          }
+        }
+  }
+};
+
+/// Calls fun(worker, d) for every worker touched by every periodic image of the particle
+template <class F> void ForEachImage(const WorkerBins& bins, const Particle& p, const bool* periodic, const double* periodicity, F fun) {
+  int minper[3], maxper[3], d[3];
+  for (int j = 0; j < 3; j++) {
+    if (periodic[j]) {
+      double prd = periodicity[j];
+      maxper[j] = floor((bins.U[j] - p.x[j] + p.r) / prd);
+      minper[j] = ceil((bins.L[j] - p.x[j] - p.r) / prd);
+    } else {
+      minper[j] = 0;
+      maxper[j] = 0;
+    }
+  }
+  for (d[0] = minper[0]; d[0] <= maxper[0]; d[0]++) {
+    for (d[1] = minper[1]; d[1] <= maxper[1]; d[1]++) {
+      for (d[2] = minper[2]; d[2] <= maxper[2]; d[2]++) {
+        double px[3];
+        for (int j = 0; j < 3; j++)
+          px[j] = p.x[j] + d[j] * periodicity[j];
+        bins.Touching(px, p.r, [&](int worker) { fun(worker, d); });
+      }
+    }
+  }
+}
+
+/// Simple particle integrator
+/**
+  Particles move with a prescribed velocity, or under the forces calculated
+  by the coupled code. Used by the standalone simplepart program (coupled
+  through MPI) and in-process by the RemoteForceInterface handler.
+*/
+class SimplePart {
+  Particles particles;
+  double dt;
+  int iter;
+
+  bool logging;
+  std::string logging_filename;
+  int logging_iter;
+  FILE* logging_f;
+  bool avg;
+  bool log_position;
+  bool log_velocity;
+  bool log_force;
+  bool log_omega;
+  bool log_torque;
+  size_t logging_n; ///< Number of logged particles
+  static const int logging_size = 15;
+  std::vector<double> logging_buf; ///< Logged values of the particles
+
+  double periodicity[3], periodic_origin[3];
+  bool periodic[3];
+  double acc_vec[3];
+  double acc_freq;
+
+  MPI_Comm comm;
+  int rank, size;
+  bool replicated; ///< All ranks integrate all the particles (and the forces are summed over the ranks)
+
+  WorkerBins bins;
+  std::vector<size_t> wsize;
+  std::vector<size_t> pstart; ///< Images of particle k are images[pstart[k]] ... images[pstart[k+1]-1]
+  std::vector<Image> images;
+  static const long int nchunks = 64;
+  std::vector<size_t> chunk_offset;
+
+  int Parse(pugi::xml_node main_node) {
+    for (pugi::xml_attribute attr = main_node.first_attribute(); attr; attr = attr.next_attribute()) {
+      std::string attr_name = attr.name();
+      if (attr_name == "dt") {
+        dt = attr.as_double();
+      } else if (attr_name == "ax") {
+        acc_vec[0] = attr.as_double();
+      } else if (attr_name == "ay") {
+        acc_vec[1] = attr.as_double();
+      } else if (attr_name == "az") {
+        acc_vec[2] = attr.as_double();
+      } else if (attr_name == "afreq") {
+        acc_freq = attr.as_double();
+      } else {
+        ERROR("Unknown atribute '%s' in '%s'", attr.name(), main_node.name());
+        return -1;
+      }
+    }
+
+    for (pugi::xml_node node = main_node.first_child(); node; node = node.next_sibling()) {
+      std::string node_name = node.name();
+      if (node_name == "Particle") {
+        Particle p;
+        for (pugi::xml_attribute attr = node.first_attribute(); attr; attr = attr.next_attribute()) {
+          attr_name_t attr_name = attr.name();
+          if (attr_name.vector == "") {
+            p.x[attr_name.d] = attr.as_double();
+          } else if (attr_name.vector == "v") {
+            p.v0[attr_name.d] = attr.as_double();
+          } else if (attr_name.vector == "omega") {
+            p.omega0[attr_name.d] = attr.as_double();
+          } else if (attr_name == "r") {
+            p.r = attr.as_double();
+          } else if (attr_name == "m") {
+            p.m = attr.as_double();
+          } else if (attr_name == "log") {
+            p.logging = attr.as_bool();
+          } else if (attr_name == "ease-in") {
+            p.ease_in_time = attr.as_double();
+          } else {
+            ERROR("Unknown atribute '%s' in '%s'", attr.name(), node.name());
+            return -1;
+          }
+        }
+        if (p.r <= 0.0) {
+          ERROR("Specify the radius with 'r' attribute");
+          return -1;
+        }
+        if (p.ease_in_time > 0) {
+          for (int i=0;i<3;i++) {
+            p.v[i] = 0;
+            p.omega[i] = 0;
+          }
+        } else {
+          for (int i=0;i<3;i++) {
+            p.v[i] = p.v0[i];
+            p.omega[i] = p.omega0[i];
+          }
+        }
+        p.n = particles.size();
+        particles.push_back(p);
+      } else if (node_name == "Periodic") {
+        for (pugi::xml_attribute attr = node.first_attribute(); attr; attr = attr.next_attribute()) {
+          attr_name_t attr_name = attr.name();
+          if (attr_name.vector == "") {
+            periodic[attr_name.d] = true;
+            periodicity[attr_name.d] = attr.as_double();
+          } else if (attr_name.vector == "p") {
+            periodic_origin[attr_name.d] = attr.as_double();
+          } else {
+            ERROR("Unknown atribute '%s' in '%s'", attr.name(), node.name());
+            return -1;
+          }
+        }
+      } else if (node_name == "Log") {
+        if (logging) {
+            ERROR("There can be only one '%s' element", node.name());
+            return -1;
+        } 
+        for (pugi::xml_attribute attr = node.first_attribute(); attr; attr = attr.next_attribute()) {
+          std::string attr_name = attr.name();
+          logging = true;
+          if (attr_name == "name") {
+            logging_filename = attr.value();
+          } else if (attr_name == "Iterations") {
+            logging_iter = attr.as_int();
+            if (logging_iter < 1) {
+              ERROR("The '%s' attribute in '%s' have to be higher then 1", attr.name(), node.name());
+              return -1;
+            }
+          } else if (attr_name == "average") {
+            avg = attr.as_bool();
+            if (avg) notice("SIMPLEPART: Particle force averaging is ON");
+          } else if (attr_name == "rotation") {
+            log_omega = attr.as_bool();
+            log_torque = log_omega;
+            if (log_omega) notice("SIMPLEPART: Particle omega and torque is logged");
+          } else {
+            ERROR("Unknown atribute '%s' in '%s'", attr.name(), node.name());
+            return -1;
+          }
+        }
+        if (logging && logging_filename == "") {
+          ERROR("Loggin file name not set in '%s' element", node.name());
+          return -1;
+        }
+      } else {
+        ERROR("Unknown node '%s' in '%s'", node.name(), main_node.name());
+        return -1;
+      }
+    }
+    return 0;
+  }
+
+  int OpenLog() {
+    logging_n = 0;
+    for (Particles::iterator p = particles.begin(); p != particles.end(); p++) if (p->logging) {
+      p->log_index = logging_n;
+      logging_n++;
+    }
+    logging_buf.resize(logging_n * logging_size);
+    if (logging && rank == 0) {
+      logging_f = fopen(logging_filename.c_str(), "w");
+      if (logging_f == NULL) {
+        ERROR("Failed to open '%s' for writing", logging_filename.c_str());
+        return -1;
+      }
+      fprintf(logging_f, "Iteration,Time");
+      for (Particles::iterator p = particles.begin(); p != particles.end(); p++) if (p->logging) {
+        size_t n = p->n;
+        if (log_position) fprintf(logging_f, ",p%2$ld_%1$sx,p%2$ld_%1$sy,p%2$ld_%1$sz","",n);
+        if (log_velocity) fprintf(logging_f, ",p%2$ld_%1$sx,p%2$ld_%1$sy,p%2$ld_%1$sz","v",n);
+        if (log_force) fprintf(logging_f, ",p%2$ld_%1$sx,p%2$ld_%1$sy,p%2$ld_%1$sz","f",n);
+        if (log_omega) fprintf(logging_f, ",p%2$ld_%1$sx,p%2$ld_%1$sy,p%2$ld_%1$sz","o",n);
+        if (log_torque) fprintf(logging_f, ",p%2$ld_%1$sx,p%2$ld_%1$sy,p%2$ld_%1$sz","t",n);
+      }
+      fprintf(logging_f, "\n");
+    }
+    return 0;
+  }
+
+  void Log() {
+    if (! logging || (iter % logging_iter != 0)) return;
+    // Logged values are gathered on the first rank
+    std::fill(logging_buf.begin(), logging_buf.end(), 0.0);
+    for (Particles::iterator p = particles.begin(); p != particles.end(); p++) if (p->logging) {
+      double* buf = &logging_buf[p->log_index * logging_size];
+      for (int i=0; i<3; i++) {
+        buf[i] = p->x[i];
+        buf[3+i] = p->v[i];
+        if (avg) {
+          buf[6+i] = p->favg[i]/logging_iter;
+          p->favg[i] = 0;
+        } else {
+          buf[6+i] = p->f[i];
+        }
+        buf[9+i] = p->omega[i];
+        buf[12+i] = p->torque[i];
+      }
+    }
+    if (! replicated && size > 1) {
+      if (rank == 0) {
+        MPI_Reduce(MPI_IN_PLACE, logging_buf.data(), logging_buf.size(), MPI_DOUBLE, MPI_SUM, 0, comm);
+      } else {
+        MPI_Reduce(logging_buf.data(), NULL, logging_buf.size(), MPI_DOUBLE, MPI_SUM, 0, comm);
+      }
+    }
+    if (logging_f != NULL) {
+      fprintf(logging_f, "%d,%.15lg", iter, dt*iter);
+      for (size_t k=0; k<logging_n; k++) {
+        const double* buf = &logging_buf[k * logging_size];
+        if (log_position) for (int i=0; i<3; i++) fprintf(logging_f, ",%.15lg", buf[i]);
+        if (log_velocity) for (int i=0; i<3; i++) fprintf(logging_f, ",%.15lg", buf[3+i]);
+        if (log_force) for (int i=0; i<3; i++) fprintf(logging_f, ",%.15lg", buf[6+i]);
+        if (log_omega) for (int i=0; i<3; i++) fprintf(logging_f, ",%.15lg", buf[9+i]);
+        if (log_torque) for (int i=0; i<3; i++) fprintf(logging_f, ",%.15lg", buf[12+i]);
+      }
+      fprintf(logging_f, "\n");
+    }
+  }
+
+  void Advance() {
+    for (Particles::iterator p = particles.begin(); p != particles.end(); p++) {
+      double t = dt * iter;
+      for (int i=0; i<3; i++) p->favg[i] = p->favg[i] + p->f[i];
+      if (p->ease_in_time > 0) {
+        if (p->ease_in_time > t) {
+          double fac = (1-cos(pi * t / p->ease_in_time))*0.5;
+          for (int i=0; i<3; i++) p->v[i] = p->v0[i] * fac;
+          for (int i=0; i<3; i++) p->omega[i] = p->omega0[i] * fac;
+        } else {
+          for (int i=0; i<3; i++) p->v[i] = p->v0[i];
+          for (int i=0; i<3; i++) p->omega[i] = p->omega0[i];
+          p->ease_in_time = 0;
+        }
+      } else {
+        if (p->m > 0.0) {
+          for (int i=0; i<3; i++) p->v[i] = p->v[i] + p->f[i] / p->m * dt;
+        }
+        for (int i=0; i<3; i++) p->v[i] = p->v[i] + acc_vec[i] * cos(twopi * t * acc_freq);
+      }
+      for (int i=0; i<3; i++) p->x[i] = p->x[i] + p->v[i] * dt;
+    }
+    iter++;
+  }
+
+public:
+  SimplePart() {
+    dt = 1;
+    iter = 0;
+    logging = false;
+    logging_iter = 1;
+    logging_f = NULL;
+    avg = false;
+    log_position = true;
+    log_velocity = true;
+    log_force = true;
+    log_omega = false;
+    log_torque = false;
+    logging_n = 0;
+    for (int i = 0; i < 3; i++) {
+      periodic[i] = false;
+      periodicity[i] = 0.0;
+      periodic_origin[i] = 0.0;
+      acc_vec[i] = 0.0;
+    }
+    acc_freq = 0.0;
+    comm = MPI_COMM_NULL;
+    rank = 0;
+    size = 1;
+    replicated = false;
+  }
+
+  ~SimplePart() {
+    if (logging_f != NULL) fclose(logging_f);
+  }
+
+  /// Read the configuration (from the file, or sent by the calculator) and prepare the particles
+  /**
+    If replicated is false, the particles are divided between the ranks of comm
+    (round robin by their number) and every rank sends its own particles to all workers.
+    Otherwise every rank keeps all the particles and the forces are summed over the ranks.
+  */
+  template <class RFI_t> int Init(RFI_t& RFI, const char* filename, MPI_Comm comm_, bool replicated_) {
+    comm = comm_;
+    replicated = replicated_;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    dt = RFI.auto_timestep;
+    if (RFI.hasVar("output")) logging_filename = RFI.getVar("output") + "_SP_Log.csv";
+
+    pugi::xml_document config;
+    pugi::xml_parse_result result;
+    if (filename != NULL) {
+      if (RFI.hasVar("content")) {
+        WARNING("Ignoring content (configuration) sent by calculator");
+      }
+      result = config.load_file(filename, pugi::parse_default | pugi::parse_comments);
+    } else {
+      if (RFI.hasVar("content")) {
+        result = config.load_string(RFI.getVar("content").c_str(), pugi::parse_default | pugi::parse_comments);
+      } else {
+        ERROR("No configuration provided (either xml file or content from force calculator)\n");
+        return -1;
+      }
+    }
+    if (!result) {
+      ERROR("Error while parsing %s: %s\n", filename, result.description());
+      return -1;
+    }
+
+    pugi::xml_node main_node = config.child("SimplePart");
+    if (! main_node) {
+      ERROR("No SimplePart element in %s", filename);
+      return -1;
+    }
+    if (Parse(main_node)) return -1;
+    if (OpenLog()) return -1;
+    if (! replicated && size > 1) {
+      Particles mine;
+      for (Particles::iterator p = particles.begin(); p != particles.end(); p++) {
+        if (p->n % size == (size_t) rank) mine.push_back(*p);
+      }
+      particles.swap(mine);
+      output("SIMPLEPART: %ld particles on this rank\n", particles.size());
+    }
+    for (Particles::iterator p = particles.begin(); p != particles.end(); p++) {
+      for (int i=0; i<3; i++) p->v[i] = p->v[i] - acc_vec[i] / 2.0;
+    }
+    bins.Build(RFI, periodicity);
+    wsize.resize(RFI.Workers());
+    return 0;
+  }
+
+  /// Assign the particles (and their periodic images) to the workers and send them
+  template <class RFI_t> void SendParticles(RFI_t& RFI) {
+    long int np = particles.size();
+    pstart.assign(np + 1, 0);
+    #pragma omp parallel for schedule(dynamic, 64)
+    for (long int k = 0; k < np; k++) {
+      size_t count = 0;
+      ForEachImage(bins, particles[k], periodic, periodicity, [&count](int, const int*) { count++; });
+      pstart[k+1] = count;
+    }
+    for (long int k = 0; k < np; k++) pstart[k+1] += pstart[k];
+    long int nimg = pstart[np];
+    images.resize(nimg);
+    #pragma omp parallel for schedule(dynamic, 64)
+    for (long int k = 0; k < np; k++) {
+      Image* img = &images[pstart[k]];
+      ForEachImage(bins, particles[k], periodic, periodicity, [&img, k](int worker, const int* d) {
+        img->p = k;
+        img->worker = worker;
+        for (int j = 0; j < 3; j++) img->d[j] = d[j];
+        img++;
+      });
+    }
+
+    // Images are ordered by worker (keeping the order of particles),
+    //  with per-chunk counts and prefix sums giving the place of each one.
+    int workers = RFI.Workers();
+    chunk_offset.assign(nchunks * workers, 0);
+    #pragma omp parallel for schedule(static)
+    for (long int c = 0; c < nchunks; c++) {
+      size_t* count = &chunk_offset[c * workers];
+      for (long int k = nimg * c / nchunks; k < nimg * (c+1) / nchunks; k++) count[images[k].worker]++;
+    }
+    size_t offset = 0;
+    for (int worker = 0; worker < workers; worker++) {
+      wsize[worker] = 0;
+      for (long int c = 0; c < nchunks; c++) {
+        size_t count = chunk_offset[c * workers + worker];
+        chunk_offset[c * workers + worker] = offset;
+        offset += count;
+        wsize[worker] += count;
+      }
+      RFI.Size(worker) = wsize[worker];
+    }
+    #pragma omp parallel for schedule(static)
+    for (long int c = 0; c < nchunks; c++) {
+      size_t* next = &chunk_offset[c * workers];
+      for (long int k = nimg * c / nchunks; k < nimg * (c+1) / nchunks; k++) images[k].i = next[images[k].worker]++;
+    }
+    RFI.SendSizes();
+    RFI.Alloc();
+
+    #pragma omp parallel for schedule(static)
+    for (long int k = 0; k < nimg; k++) {
+      const Image& img = images[k];
+      const Particle& p = particles[img.p];
+      size_t i = img.i;
+      RFI.setData(i, RFI_DATA_R, p.r);
+      for (int j = 0; j < 3; j++) {
+        RFI.setData(i, RFI_DATA_POS + j, p.x[j] + img.d[j] * periodicity[j]);
+        RFI.setData(i, RFI_DATA_VEL + j, p.v[j]);
+      }
+      if (RFI.Rot()) {
+        for (int j = 0; j < 3; j++) RFI.setData(i, RFI_DATA_ANGVEL + j, p.omega[j]);
+      }
+    }
+    RFI.SendParticles();
+  }
+
+  /// Receive the forces, and move the particles
+  template <class RFI_t> void GetForces(RFI_t& RFI) {
+    RFI.SendForces();
+    long int np = particles.size();
+    #pragma omp parallel for schedule(static)
+    for (long int k = 0; k < np; k++) {
+      Particle& p = particles[k];
+      for (int j = 0; j < 3; j++) {
+        p.f[j] = 0;
+        p.torque[j] = 0;
+      }
+      for (size_t m = pstart[k]; m < pstart[k+1]; m++) {
+        size_t i = images[m].i;
+        for (int j = 0; j < 3; j++) p.f[j] += RFI.getData(i, RFI_DATA_FORCE + j);
+        if (RFI.Rot()) {
+          for (int j = 0; j < 3; j++) p.torque[j] += RFI.getData(i, RFI_DATA_MOMENT + j);
+        }
+      }
+    }
+    if (replicated && size > 1) {
+      std::vector<double> buf(6 * np);
+      for (long int k = 0; k < np; k++) {
+        for (int j = 0; j < 3; j++) {
+          buf[6*k+j] = particles[k].f[j];
+          buf[6*k+3+j] = particles[k].torque[j];
+        }
+      }
+      MPI_Allreduce(MPI_IN_PLACE, buf.data(), buf.size(), MPI_DOUBLE, MPI_SUM, comm);
+      for (long int k = 0; k < np; k++) {
+        for (int j = 0; j < 3; j++) {
+          particles[k].f[j] = buf[6*k+j];
+          particles[k].torque[j] = buf[6*k+3+j];
+        }
+      }
+    }
+    Log();
+    Advance();
+  }
+};
+
+/// SimplePart run in-process, called in-loop by the force calculator
+template <class RFI_T> class LocalSimplePart : public rfi::LocalIntegrator {
+public:
+  typename RFI_T::partner_t RFI; ///< Integrator side of the in-process connection
+  SimplePart SP;
+  void Particles() { SP.SendParticles(RFI); }
+  void Forces() { SP.GetForces(RFI); }
+};
+
+};
+
+#endif // SIMPLEPART_HPP
@@ -5,6 +5,7 @@
 #include <vector>
 #include <set>
 #include <math.h>
+#include <algorithm>
 #include "SolidGrid.h"
 
 template <class BALLS>
@@ -12,23 +13,33 @@ int SolidGrid<BALLS>::TryDepth(size_t grid_size) {
     // printf("Trying depth: %d\n", depth);
     size_t data_size = grid_size * depth;
     data.resize(data_size);
-    for (size_t i=0; i<data.size(); i++) data[i] = -1;
-    for (size_t i=0; i<balls->size(); i++) {
+    std::vector<int> count(grid_size, 0);
+    long int n = balls->size();
+    int overflow = 0;
+    #pragma omp parallel for schedule(static) reduction(+:overflow)
+    for (long int i=0; i<n; i++) {
         size_t data_offset = 0;
         for (int k=0; k<3; k++) {
             double val = balls->getPos(i,k);
             int p = floor(val/delta);
             data_offset = data_offset * (maxs[k]-mins[k]+1) + p - mins[k];
         }
-        data_offset = data_offset * depth;
-        int k = 0;
-        while (data[data_offset + k] != -1) {
-            k++;
-            if (k >= depth) {
-                return -1;
-            }
+        int k;
+        #pragma omp atomic capture
+        k = count[data_offset]++;
+        if (k < depth) {
+            data[data_offset * depth + k] = i;
+        } else {
+            overflow++;
         }
-        data[data_offset + k] = i;
+    }
+    if (overflow > 0) return -1;
+    // Bins are sorted, so that the result does not depend on the order of insertion
+    #pragma omp parallel for schedule(static)
+    for (long int c=0; c<(long int) grid_size; c++) {
+        gr_addr_t * bin = &data[c * depth];
+        std::sort(bin, bin + count[c]);
+        for (int k=count[c]; k<depth; k++) bin[k] = -1;
     }
     return 0;
 }
@@ -38,23 +49,25 @@ void SolidGrid<BALLS>::Build () {
     if (balls->size() > 0) {
         double maxr = 0.5;
         if (depth < 1) depth = 4;
-        for (size_t i=0; i<balls->size(); i++) {
+        long int n = balls->size();
+        #pragma omp parallel for schedule(static) reduction(max:maxr)
+        for (long int i=0; i<n; i++) {
             double val = balls->getRad(i);
             if (maxr < val) maxr = val;
         }
         delta = 2*maxr;
         // printf("delta: %lf\n", delta);
         for (int k=0; k<3; k++) {
-            mins[k] = 0xFFFFFF;
-            maxs[k] = -0xFFFFFF;
-        }
-        for (size_t i=0; i<balls->size(); i++) {
-            for (int k=0; k<3; k++) {
+            int mn = 0xFFFFFF, mx = -0xFFFFFF;
+            #pragma omp parallel for schedule(static) reduction(min:mn) reduction(max:mx)
+            for (long int i=0; i<n; i++) {
                 double val = balls->getPos(i,k);
                 int p = floor(val/delta);
-                if (mins[k] > p) mins[k] = p;
-                if (maxs[k] < p) maxs[k] = p;
+                if (mn > p) mn = p;
+                if (mx < p) mx = p;
             }
+            mins[k] = mn;
+            maxs[k] = mx;
         }
         size_t grid_size = 1;
         for (int k=0; k<3; k++) grid_size = grid_size * (maxs[k]-mins[k]+1);
@@ -12,21 +12,34 @@ void SyntheticTurbulence::CopyToGPU(STWaveSet & ST) {
  }
 }
 
-void runif(int n, double * tab) {
+/// Mix the bits of a 64-bit integer (splitmix64 finalizer)
+static inline unsigned long long int st_mix(unsigned long long int z) {
+ z += 0x9E3779B97F4A7C15ULL;
+ z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+ z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+ return z ^ (z >> 31);
+}
+
+/// Uniform numbers in (0,1) depending only on the seed, mode and position in the mode
+/**
+  Counter-based, so that all modes can be generated independently
+  and the result does not depend on the order of generation
+*/
+void runif(unsigned long long int seed, int mode, int first, int n, double * tab) {
+ unsigned long long int s = st_mix(seed ^ st_mix(mode));
  for (int i=0;i<n;i++)
-   tab[i] = (double)rand()/RAND_MAX;
+   tab[i] = ((st_mix(s + first + i) >> 11) + 0.5) / 9007199254740992.0;
 }
 
-void rnorm(int n, double *tab) {
-  for (int i=0;i<n;i++) {
+/// Normal numbers (Box-Muller), every pair made from its own two uniform numbers (counters i and i+1)
+void rnorm(unsigned long long int seed, int mode, int n, double *tab) {
+  for (int i=0;i<n;i+=2) {
    double w[2];
-   runif(2, w);
+   runif(seed, mode, i, 2, w);
    w[0] = w[0] * atan(1.0) * 8;
    w[1] = sqrt(-log(w[1]));
    tab[i] = cos(w[0])*w[1];
-   i++;
-   if (i >= n) break;
-   tab[i] = sin(w[0])*w[1];
+   if (i+1 < n) tab[i+1] = sin(w[0])*w[1];
   }
 }
 
@@ -43,15 +56,21 @@ SyntheticTurbulence::SyntheticTurbulence() {
  WaveLengths = NULL; 
  TimeWN = 0;
  cpuset.TimeWN = 0;
+ seed = 0;
 }
  
 
+/// Generate the random modes
+/**
+  All modes are generated on the first rank and broadcasted at once
+*/
 void SyntheticTurbulence::Generate() {
- double tab[6];
  assert(size == cpuset.nmodes);
- for (int j=0;j<size;j++) {
-  if (D_MPI_RANK == 0) {
-   rnorm(6,tab);
+ if (D_MPI_RANK == 0) {
+  #pragma omp parallel for
+  for (int j=0;j<size;j++) {
+   double tab[6];
+   rnorm(seed, j, 6, tab);
    double l;
    l = sqrt(skal(3,tab,tab));
    for (int i=0;i<3;i++) tab[i] /= l;
@@ -59,13 +78,20 @@ void SyntheticTurbulence::Generate() {
    for (int i=0;i<3;i++) tab[i+3] -= tab[i]*l;
    l = sqrt(skal(3,tab+3,tab+3));
    for (int i=0;i<3;i++) tab[i+3] *= Amplitudes[j]/l;
-   for (int i=0;i<6;i++) 
-    cpuset.data[j*ST_DATA+i] = tab[i];
-   cpuset.data[j*ST_DATA+ST_WAVE_L] = WaveLengths[j];
+   real_t * d = &cpuset.data[j*ST_DATA];
+   d[ST_WAVE_X] = tab[0]*WaveLengths[j];
+   d[ST_WAVE_Y] = tab[1]*WaveLengths[j];
+   d[ST_WAVE_Z] = tab[2]*WaveLengths[j];
+   d[ST_SINE_X] = tab[3];
+   d[ST_SINE_Y] = tab[4];
+   d[ST_SINE_Z] = tab[5];
+   d[ST_WAVE_L] = WaveLengths[j];
+   d[ST_COS_X] = tab[1]*tab[5] - tab[2]*tab[4];
+   d[ST_COS_Y] = tab[2]*tab[3] - tab[0]*tab[5];
+   d[ST_COS_Z] = tab[0]*tab[4] - tab[1]*tab[3];
   }
-  MPI_Bcast( cpuset.data, ST_DATA*size, MPI_REAL_T, 0, MPMD.local);
  }
-  
+ if (size > 0) MPI_Bcast( cpuset.data, ST_DATA*size, MPI_REAL_T, 0, MPMD.local);
 }
 
 void SyntheticTurbulence::resize(int n) {
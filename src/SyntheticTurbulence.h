@@ -6,7 +6,7 @@
 #include "types.h"
 #include <math.h>
 #include <stdlib.h>
-#define ST_DATA 7
+#define ST_DATA 10
 #define ST_WAVE_X 0
 #define ST_WAVE_Y 1
 #define ST_WAVE_Z 2
@@ -14,6 +14,9 @@
 #define ST_SINE_Y 4
 #define ST_SINE_Z 5
 #define ST_WAVE_L 6
+#define ST_COS_X 7
+#define ST_COS_Y 8
+#define ST_COS_Z 9
 #define ST_GPU 0
 #define ST_CPU 1
 
@@ -72,6 +75,7 @@ private:
  double MaxEnWaveLen, DissWaveLen;
  double *WaveLengths, *Amplitudes;
  eSpread spread;
+ unsigned long long int seed;
 public:
  SyntheticTurbulence();
  void CopyToGPU(STWaveSet & ST);
@@ -83,26 +87,36 @@ public:
  void setOneWave(double L); 
  void setTimeScale(double L); 
  inline void setSpread(eSpread s) {spread = s;}
+ inline void setSeed(unsigned long long int s) {seed = s;}
  void resize(int n);
 };
 
 
+inline CudaDeviceFunction void st_sincos(real_t w, real_t * sw, real_t * cw) {
+#if defined(__CUDA_ARCH__) || defined(__HIP_DEVICE_COMPILE__)
+  sincos(w, sw, cw);
+#else
+  *sw = sin(w); *cw = cos(w); // fused to sincos by the compiler
+#endif
+}
+
+/// Evaluate the synthetic turbulence
+/**
+  The wave vectors (scaled by the wave number) and the coefficients of
+  the sine and cosine parts are precomputed in Generate, so a mode costs
+  a dot product, one sincos and six multiply-adds.
+*/
 inline CudaDeviceFunction vector_t calc(const STWaveSet &ST, real_t x, real_t y, real_t z) {
   vector_t ret;
   ret.x=0;ret.y=0;ret.z=0;
   for (int i=0; i<ST.nmodes; i++) {
-    real_t x1 = ST.data[i*ST_DATA+ST_WAVE_X];
-    real_t y1 = ST.data[i*ST_DATA+ST_WAVE_Y];
-    real_t z1 = ST.data[i*ST_DATA+ST_WAVE_Z];
-    real_t x2 = ST.data[i*ST_DATA+ST_SINE_X];
-    real_t y2 = ST.data[i*ST_DATA+ST_SINE_Y];
-    real_t z2 = ST.data[i*ST_DATA+ST_SINE_Z];
-    real_t w = ST.data[i*ST_DATA+ST_WAVE_L];
-    w = (x1*x + y1*y + z1*z) * w;
-    real_t sw = sin(w), cw = cos(w);
-    ret.x += sw*x2 + cw*(y1*z2-z1*y2);
-    ret.y += sw*y2 + cw*(z1*x2-x1*z2);
-    ret.z += sw*z2 + cw*(x1*y2-y1*x2);
+    const real_t * d = &ST.data[i*ST_DATA];
+    real_t w = d[ST_WAVE_X]*x + d[ST_WAVE_Y]*y + d[ST_WAVE_Z]*z;
+    real_t sw, cw;
+    st_sincos(w, &sw, &cw);
+    ret.x += sw*d[ST_SINE_X] + cw*d[ST_COS_X];
+    ret.y += sw*d[ST_SINE_Y] + cw*d[ST_COS_Y];
+    ret.z += sw*d[ST_SINE_Z] + cw*d[ST_COS_Z];
   }
   return ret;
 }
@@ -12,6 +12,9 @@ class ZoneSettings {
   real_t * cpuConst;
   const int zonesettings;
   const int zones;
+  bool tab_dirty; ///< The table of pointers to the time series changed since the last upload
+  bool const_dirty; ///< The constant values changed since the last upload
+  bool * dirty; ///< Time series changed since the last upload
   inline int dt_offset() { return zones * zonesettings; }
   inline int time_seg() { return 4 * zones * zonesettings; }
   inline int grad_offset() { return  2 * zones * zonesettings; }
@@ -39,6 +42,13 @@ public:
     for (int i=0; i<time_seg(); i++) {
       cpuConst[i] = 0.0;
     }
+    dirty = (bool*) malloc(sizeof(bool) * time_seg());
+    assert(time_seg() == 0 || dirty != NULL);
+    for (int i=0; i<time_seg(); i++) {
+      dirty[i] = false;
+    }
+    tab_dirty = true;
+    const_dirty = true;
     DEBUG_M;
     debug0("&gpuTab: %p, size: %ld\n", &gpuTab, sizeof(real_t*) * time_seg());
     CudaMalloc((void**) &gpuTab, sizeof(real_t*) * time_seg());
@@ -76,7 +86,7 @@ public:
     } else {
       cpuConst[s+zonesettings*z] = val;
     }
-    CopyToGPU();  
+    const_dirty = true;
   }
   
   inline void setLen(size_t nlen) {
@@ -91,13 +101,14 @@ public:
       }
     }
     len = nlen;
-    CopyToGPU();  
+    tab_dirty = true;
   }    
 
   inline void Alloc(int i) {
     if (cpuValues[i] == NULL) {
       cpuValues[i] = (real_t*) malloc(sizeof(real_t) * len);
       CudaMalloc(&cpuTab[i], sizeof(real_t) * len);
+      tab_dirty = true;
     }
   }    
 
@@ -117,6 +128,8 @@ public:
     }
     cpuValues[i+dt_offset()][0] = (val[1] - val[len-1])/2;
     cpuValues[i+dt_offset()][len-1] = (val[0] - val[len-2])/2;
+    dirty[i] = true;
+    dirty[i+dt_offset()] = true;
     Alloc(i+grad_offset());
     Alloc(i+grad_offset()+dt_offset());
     for (size_t j=0; j<len; j++) {
@@ -126,6 +139,31 @@ public:
   }
 
 
+  inline void copy(const ZoneSettings& other) {
+    assert(zonesettings == other.zonesettings);
+    assert(zones == other.zones);
+    setLen(other.len);
+    zone_max(other.MaxZones-1);
+    for (int i=0; i<grad_offset(); i++) {
+      cpuConst[i] = other.cpuConst[i];
+    }
+    for (int i=0; i<dt_offset(); i++) if (other.cpuValues[i] != NULL) {
+      Alloc(i);
+      Alloc(i+dt_offset());
+      Alloc(i+grad_offset());
+      Alloc(i+grad_offset()+dt_offset());
+      for (size_t j=0; j<len; j++) {
+        cpuValues[i][j] = other.cpuValues[i][j];
+        cpuValues[i+dt_offset()][j] = other.cpuValues[i+dt_offset()][j];
+        cpuValues[i+grad_offset()][j] = 0;
+        cpuValues[i+grad_offset()+dt_offset()][j] = 0;
+      }
+      dirty[i] = true;
+      dirty[i+dt_offset()] = true;
+    }
+    const_dirty = true;
+  }
+
   inline void set(int s, int z, std::vector<double> val) {
     assert(s >=  0);
     assert(s <   zonesettings);
@@ -142,7 +180,6 @@ public:
       int i = s+zonesettings*z;
       set_internal(i,val);
     }
-    CopyToGPU();  
   }
 
   inline void set(int s, int z, const double* val) {
@@ -160,7 +197,6 @@ public:
       int i = s+zonesettings*z;
       set_internal(i,val);
     }
-    CopyToGPU();  
   }
   
   inline double get(int s, int z, size_t it) {
@@ -232,15 +268,19 @@ public:
   }
 
   
+/// Upload the values changed since the last upload to the GPU
   inline void CopyToGPU () {
     DEBUG_M;
-    CudaMemcpy(gpuTab,   cpuTab,   sizeof(real_t*) * time_seg(), CudaMemcpyHostToDevice);
-    CudaMemcpy(gpuConst, cpuConst, sizeof(real_t)  * grad_offset(), CudaMemcpyHostToDevice);
+    if (tab_dirty) CudaMemcpy(gpuTab,   cpuTab,   sizeof(real_t*) * time_seg(), CudaMemcpyHostToDevice);
+    if (const_dirty) CudaMemcpy(gpuConst, cpuConst, sizeof(real_t)  * grad_offset(), CudaMemcpyHostToDevice);
     DEBUG_M;
-    for (int i=0; i<grad_offset(); i++) if (cpuValues[i] != NULL) {
+    for (int i=0; i<grad_offset(); i++) if (cpuValues[i] != NULL && dirty[i]) {
       assert(cpuTab[i] != NULL);
       CudaMemcpy(cpuTab[i],   cpuValues[i],  sizeof(real_t) * len, CudaMemcpyHostToDevice);
     }
+    for (int i=0; i<time_seg(); i++) dirty[i] = false;
+    tab_dirty = false;
+    const_dirty = false;
   }
 
   inline void ClearGrad () {
@@ -265,6 +305,7 @@ public:
       if (cpuTab[i] != NULL) CudaFree(cpuTab[i]);
     }
     free(cpuTab);
+    free(dirty);
     CudaFree(gpuTab);
     free(cpuConst);
     CudaFree(gpuConst);
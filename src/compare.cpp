@@ -1,4 +1,5 @@
 #include "pugixml.hpp"
+#include "BlockCompress.h"
 #include <iostream>
 #include <assert.h>
 #include <stdio.h>
@@ -61,6 +62,18 @@ struct base64decoder {
 		dc64((unsigned char *)txt, ptr, nlen);
 		*optr = ptr;
 	}
+
+	int decode64(const char *txt, void **optr) {
+		int nlen;
+		unsigned char *ptr;
+		txt += 1;
+		dc64((unsigned char *)txt, (unsigned char *)&nlen, 4);
+		txt += 8;
+		ptr = (unsigned char *)malloc(nlen);
+		dc64((unsigned char *)txt, ptr, nlen);
+		*optr = ptr;
+		return nlen;
+	}
 };
 
 const char *base64decoder::base64char = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
@@ -72,8 +85,10 @@ struct TabBase {
 	std::string ftype;
 	size_t size;
 	size_t totsize;
+	size_t raw_bytes; ///< Size of the compressed pieces after decompression
+	size_t stored_bytes; ///< Size of the compressed pieces in the files
 	TabBase(int dx_, int dy_, int dz_, int nx_, int ny_, int nz_, int comp_, std::string fname_, std::string ftype_) :
-		dx(dx_), dy(dy_), dz(dz_), nx(nx_), ny(ny_), nz(nz_), comp(comp_), fname(fname_), ftype(ftype_) {
+		dx(dx_), dy(dy_), dz(dz_), nx(nx_), ny(ny_), nz(nz_), comp(comp_), fname(fname_), ftype(ftype_), raw_bytes(0), stored_bytes(0) {
 		size = 1L * (nx - dx) * (ny - dy) * (nz - dz);
 		totsize = size * comp;
 	};
@@ -127,13 +142,32 @@ struct Tab : public TabBase {
 		tab.resize(totsize);
 	}
 	void read_piece(int pdx, int pdy, int pdz, int pnx, int pny, int pnz, pugi::xml_node node) {
-		assert(fname == node.attribute("Name").value());
-		assert(ftype == node.attribute("type").value());
 		assert(std::string("binary") == node.attribute("format").value());
 		assert(std::string("base64") == node.attribute("encoding").value());
 		size_t psize = 1L * (pnx - pdx) * (pny - pdy) * (pnz - pdz) * comp;
 		T *ptr;
-		b64.decode64(node.child_value(), (void **)&ptr, psize * sizeof(T));
+		if (node.attribute("compression")) {
+			assert(fname == node.attribute("FieldName").value());
+			assert(ftype == node.attribute("FieldType").value());
+			assert(comp == node.attribute("FieldComponents").as_int());
+			assert(std::string("BlockCompressor") == node.attribute("compression").value());
+			unsigned char *data;
+			int len = b64.decode64(node.child_value(), (void **)&data);
+			std::vector<double> field(psize);
+			if (BlockCompressor::Decompress(data, len, pnx - pdx, pny - pdy, pnz - pdz, comp, field.data())) {
+				printf("Wrong compressed data in %s\n", fname.c_str());
+				exit(-1);
+			}
+			free(data);
+			ptr = (T*) malloc(psize * sizeof(T));
+			for (size_t i = 0; i < psize; i++) ptr[i] = field[i];
+			raw_bytes += psize * sizeof(T);
+			stored_bytes += len;
+		} else {
+			assert(fname == node.attribute("Name").value());
+			assert(ftype == node.attribute("type").value());
+			b64.decode64(node.child_value(), (void **)&ptr, psize * sizeof(T));
+		}
 		T* tmp = ptr;
 		for (int z = pdz; z < pnz; z++) {
 			for (int y = pdy; y < pny; y++) {
@@ -179,20 +213,7 @@ struct Tabs {
 			std::string ftype = it.attribute("type").value();
 			std::string fname = it.attribute("Name").value();
 			int fcomp = it.attribute("NumberOfComponents").as_int();
-			if (ftype == "Float64") {
-				tab[fname] = new Tab<double>(dx,dy,dz,nx,ny,nz,fcomp,fname,ftype);
-			} else if (ftype == "Float32") {
-				tab[fname] = new Tab<float>(dx,dy,dz,nx,ny,nz,fcomp,fname,ftype);
-			} else if (ftype == "UInt32") {
-				tab[fname] = new Tab<unsigned int>(dx,dy,dz,nx,ny,nz,fcomp,fname,ftype);
-			} else if (ftype == "UInt16") {
-				tab[fname] = new Tab<unsigned short int>(dx,dy,dz,nx,ny,nz,fcomp,fname,ftype);
-			} else if (ftype == "UInt8") {
-				tab[fname] = new Tab<unsigned char>(dx,dy,dz,nx,ny,nz,fcomp,fname,ftype);
-			} else {
-				printf("Unknown field type: %s\n", ftype.c_str());
-				exit(-1);
-			}
+			add_tab(fname, ftype, fcomp);
 			printf("%s, ", fname.c_str());
 		}
 		printf("\n");
@@ -202,6 +223,23 @@ struct Tabs {
 		}
 	}
 
+	void add_tab(std::string fname, std::string ftype, int fcomp) {
+		if (ftype == "Float64") {
+			tab[fname] = new Tab<double>(dx,dy,dz,nx,ny,nz,fcomp,fname,ftype);
+		} else if (ftype == "Float32") {
+			tab[fname] = new Tab<float>(dx,dy,dz,nx,ny,nz,fcomp,fname,ftype);
+		} else if (ftype == "UInt32") {
+			tab[fname] = new Tab<unsigned int>(dx,dy,dz,nx,ny,nz,fcomp,fname,ftype);
+		} else if (ftype == "UInt16") {
+			tab[fname] = new Tab<unsigned short int>(dx,dy,dz,nx,ny,nz,fcomp,fname,ftype);
+		} else if (ftype == "UInt8") {
+			tab[fname] = new Tab<unsigned char>(dx,dy,dz,nx,ny,nz,fcomp,fname,ftype);
+		} else {
+			printf("Unknown field type: %s\n", ftype.c_str());
+			exit(-1);
+		}
+	}
+
 	void read_piece(pugi::xml_node el) {
 		size_t psize = 0;
 		int pdx, pdy, pdz, pnx, pny, pnz;
@@ -220,6 +258,7 @@ struct Tabs {
 		assert(pel);
 		pel = pel.child("ImageData");
 		assert(pel);
+		pugi::xml_node tfd = pel.child("FieldData");
 		pel = pel.child("Piece");
 		assert(pel);
 		pugi::xml_node tcd = pel.child("CellData");
@@ -234,6 +273,13 @@ struct Tabs {
 			}
 			printf("%s, ", fname.c_str());
 		}
+		for (pugi::xml_node it = tfd.child("DataArray"); it; it = it.next_sibling("DataArray")) {
+			if (! it.attribute("compression")) continue;
+			std::string fname = it.attribute("FieldName").value();
+			if (tab.find(fname) == tab.end()) add_tab(fname, it.attribute("FieldType").value(), it.attribute("FieldComponents").as_int());
+			tab[fname]->read_piece(pdx, pdy, pdz, pnx, pny, pnz, it);
+			printf("%s (compressed), ", fname.c_str());
+		}
 		printf("\n");
 	}
 
@@ -269,6 +315,10 @@ int main(int argc, char *argv[]) {
 			printf("%s not in second file\n", name.c_str());
 			result = false;
 		} else {
+			for (Tabs* tabs : {&tabs1, &tabs2}) {
+				TabBase * t = tabs->tab[name];
+				if (t->stored_bytes > 0) printf("%s: Compressed in %s with ratio %.2lf\n", name.c_str(), tabs->filename.c_str(), (double) t->raw_bytes / t->stored_bytes);
+			}
 			double diff = tabs1.tab[name]->compare(tabs2.tab[name],delta_x,delta_y,delta_z);
 			printf("%s: Max difference: %lg", name.c_str(), diff);
 			double auto_eps;
@@ -6,6 +6,16 @@
 #include <vector>
 #include <algorithm>
 #include <iostream>
+#include <map>
+#include <string>
+
+#ifdef CROSS_CPU
+#include <sys/mman.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+#endif
 
 #ifdef CROSS_CPU
 
@@ -18,6 +28,94 @@ void memcpy2D(void * dst_, int dpitch, const void * src_, int spitch, int width,
 	}
 }
 
+#define CPU_MEM_ALIGN 64
+#define CPU_HUGE_PAGE (2*1024*1024)
+
+/// Allocation of CPU memory for the lattice
+/**
+  Allocations are aligned to the cache line, and big allocations
+  to (transparent) huge pages. The pages are not touched here,
+  so they land on the NUMA node of the thread that first writes them.
+*/
+void * cpuMalloc(size_t size) {
+	void * ptr = NULL;
+	size_t align = CPU_MEM_ALIGN;
+	if (size >= CPU_HUGE_PAGE) align = CPU_HUGE_PAGE;
+	if (posix_memalign(&ptr, align, size) != 0) return NULL;
+#ifdef MADV_HUGEPAGE
+	if (align == CPU_HUGE_PAGE) madvise(ptr, size / CPU_HUGE_PAGE * CPU_HUGE_PAGE, MADV_HUGEPAGE);
+#endif
+	return ptr;
+}
+
+/// Parallel (first touch) memset
+/**
+  The memory consists of slabs (e.g. one field of the lattice each).
+  Every slab is divided between the OpenMP threads in the same way as
+  CPUKernelRun divides the lattice (static schedule over consecutive
+  rows), so each page is placed on the NUMA node of the thread which
+  will later process it.
+  \param slab Size of a slab in bytes (0 for one slab)
+*/
+void cpuMemsetSlabs(void * ptr_, int value, size_t size, size_t slab) {
+	char * ptr = (char*) ptr_;
+	if ((slab == 0) || (slab > size)) slab = size;
+	#pragma omp parallel
+	{
+	#ifdef CROSS_OPENMP
+		size_t nt = omp_get_num_threads(), t = omp_get_thread_num();
+	#else
+		size_t nt = 1, t = 0;
+	#endif
+		for (size_t offset = 0; offset < size; offset += slab) {
+			size_t len = min(slab, size - offset);
+			size_t begin = len * t / nt, end = len * (t+1) / nt;
+			memset(ptr + offset + begin, value, end - begin);
+		}
+	}
+}
+
+/// Report on which NUMA nodes the pages of an allocation landed
+/**
+  Samples the pages with the move_pages syscall (query only)
+*/
+void cpuReportPlacement(const void * ptr, size_t size) {
+#ifdef CROSS_OPENMP
+	if ((omp_get_max_threads() > 1) && (omp_get_proc_bind() == omp_proc_bind_false)) {
+		NOTICE("[%d] OpenMP threads are not bound (set OMP_PROC_BIND/OMP_PLACES) - the NUMA placement of memory can be lost\n", D_MPI_RANK);
+	}
+#endif
+#if defined(__linux__) && defined(SYS_move_pages)
+	const size_t max_samples = 4096;
+	size_t page = sysconf(_SC_PAGESIZE);
+	size_t begin = ((size_t) ptr + page - 1) / page * page;
+	size_t end = (size_t) ptr + size;
+	if (end <= begin) return;
+	size_t npages = (end - begin) / page;
+	size_t stride = npages / max_samples + 1;
+	std::vector<void*> pages;
+	for (size_t i = 0; i < npages; i += stride) pages.push_back((void*) (begin + i * page));
+	std::vector<int> status(pages.size(), -1);
+	if (syscall(SYS_move_pages, 0, pages.size(), pages.data(), NULL, status.data(), 0) != 0) {
+		debug1("move_pages failed - cannot report NUMA placement\n");
+		return;
+	}
+	std::map<int, size_t> count;
+	for (size_t i = 0; i < status.size(); i++) count[status[i] < 0 ? -1 : status[i]]++;
+	std::string msg;
+	char buf[100];
+	for (std::map<int, size_t>::iterator it = count.begin(); it != count.end(); it++) {
+		if (it->first < 0) {
+			sprintf(buf, " untouched: %.1f%%", 100.0 * it->second / status.size());
+		} else {
+			sprintf(buf, " node %d: %.1f%%", it->first, 100.0 * it->second / status.size());
+		}
+		msg += buf;
+	}
+	NOTICE("[%d] NUMA placement of lattice memory:%s\n", D_MPI_RANK, msg.c_str());
+#endif
+}
+
 #else
 
 // Copyright 1993-2010 NVIDIA Corporation.  All rights reserved.
@@ -38,9 +136,10 @@ CudaError HandleError( CudaError err,
         struct ptrpair {
                 void ** ptr;
                 size_t size;
-                ptrpair() { ptr=NULL; size = 0; }
-                ptrpair(const ptrpair & p) { ptr=p.ptr; size=p.size; };
-                ptrpair(void ** ptr_, size_t size_) { ptr=ptr_; size=size_; };
+                size_t slab;
+                ptrpair() { ptr=NULL; size = 0; slab = 0; }
+                ptrpair(const ptrpair & p) { ptr=p.ptr; size=p.size; slab=p.slab; };
+                ptrpair(void ** ptr_, size_t size_, size_t slab_) { ptr=ptr_; size=size_; slab=slab_; };
                 inline const bool operator< (const ptrpair & B) const {
                         return size < B.size;
                 };
@@ -49,16 +148,16 @@ CudaError HandleError( CudaError err,
         std::vector< ptrpair > ptrlist;
         std::vector< std::pair< void *, std::vector< ptrpair > > > freelist;
 
-        CudaError cudaPreAlloc(void ** ptr, size_t size) {
+        CudaError cudaPreAlloc(void ** ptr, size_t size, size_t slab) {
                 debug1("Preallocation of %d b\n", (int) size);
-                ptrlist.push_back(ptrpair(ptr, size));
+                ptrlist.push_back(ptrpair(ptr, size, slab));
         //	return cudaMalloc(ptr, size);
                 return CudaSuccess;
         }
 
         #define MEM_ALIGN 128
 
-        CudaError cudaAllocFinalize() {
+        CudaError cudaAllocFinalize(void ** block) {
                 sort(ptrlist.begin(), ptrlist.end());
                 ptrpair ptr;
                 size_t fullsize=0;
@@ -85,23 +184,41 @@ CudaError HandleError( CudaError err,
                         ERROR("FATAL ERROR: Not enaught memory! tried to allocate (cumulatice): %ld\n", fullsize);
                         exit(-1);
                 }
-                CudaMemset( tmp, 0, fullsize );
                 void * main_ptr = tmp;
                 std::vector< ptrpair > tofree;
                 while (!ptrlist.empty()) {
                         ptr = ptrlist.back();
                         debug1("[%d] Preallocation gave %d b\n", D_MPI_RANK, (int) ptr.size);
         //		cudaMalloc(ptr.ptr,ptr.size);
+                        CudaMemsetSlabs( tmp, 0, ptr.size, ptr.slab );
                         *(ptr.ptr) = (void **)tmp;
                         tmp += ptr.size;
                         tofree.push_back(ptr);
                         ptrlist.pop_back();
                 }
                 freelist.push_back(std::pair< void *, std::vector< ptrpair > > ( main_ptr, tofree));
+                if (block != NULL) *block = main_ptr;
+        #ifdef CROSS_CPU
+                cpuReportPlacement(main_ptr, fullsize);
+        #endif
                 return CudaSuccess;
         }
 
 
+        /// Free one block made by cudaAllocFinalize (and NULL the pointers placed in it)
+        CudaError cudaAllocFree(void * block) {
+                for (size_t i = 0; i < freelist.size(); i++) if (freelist[i].first == block) {
+                        CudaFree(freelist[i].first);
+                        std::vector< ptrpair >::iterator it;
+                        for (it=freelist[i].second.begin(); it != freelist[i].second.end(); it++) {
+                                *((*it).ptr) = NULL;
+                        }
+                        freelist.erase(freelist.begin() + i);
+                        break;
+                }
+                return CudaSuccess;
+        }
+
         CudaError cudaAllocFreeAll() {
                 std::pair< void *, std::vector< ptrpair > > ptr_list;
                 while (!freelist.empty()) {
@@ -120,14 +237,19 @@ CudaError HandleError( CudaError err,
 
 #else
 
-        CudaError cudaPreAlloc(void ** ptr, size_t size) {
+        CudaError cudaPreAlloc(void ** ptr, size_t size, size_t slab) {
                 debug1("Preallocation of %d b\n", (int) size);
                 CudaMalloc(ptr, size); // This macro has error checking already
-                CudaMemset( *ptr, 0, size );
+                CudaMemsetSlabs( *ptr, 0, size, slab );
+                return CudaSuccess;
+        }
+
+        CudaError cudaAllocFinalize(void ** block) {
+                if (block != NULL) *block = NULL;
                 return CudaSuccess;
         }
 
-        CudaError cudaAllocFinalize() {
+        CudaError cudaAllocFree(void * block) {
                 return CudaSuccess;
         }
 
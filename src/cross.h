@@ -81,6 +81,7 @@
 
     #define CudaMemcpyDeviceToHost cudaMemcpyDeviceToHost
     #define CudaMemcpyHostToDevice cudaMemcpyHostToDevice
+    #define CudaMemcpyDeviceToDevice cudaMemcpyDeviceToDevice
     #define CudaCopyToConstant(a__,b__,c__,d__) HANDLE_ERROR( cudaMemcpyToSymbol(b__, c__, d__, 0, cudaMemcpyHostToDevice))
     #define CudaMemcpy2D(a__,b__,c__,d__,e__,f__,g__) HANDLE_ERROR( cudaMemcpy2D(a__, b__, c__, d__, e__, f__, g__) )
     #define CudaMemcpy(a__,b__,c__,d__) HANDLE_ERROR( cudaMemcpy(a__, b__, c__, d__) )
@@ -92,12 +93,16 @@
       #define CudaMemcpyPeerAsync(a__,b__,c__,d__,e__,f__) HANDLE_ERROR( cudaMemcpyPeerAsync(a__, b__, c__, d__, e__, f__) )
     #endif
     #define CudaMemset(a__,b__,c__) HANDLE_ERROR( cudaMemset(a__, b__, c__) )
+    #define CudaMemsetAsync(a__,b__,c__,d__) HANDLE_ERROR( cudaMemsetAsync(a__, b__, c__, d__) )
+    #define CudaMemsetSlabs(a__,b__,c__,d__) CudaMemset(a__, b__, c__)
     #define CudaMalloc(a__,b__) HANDLE_ERROR( cudaMalloc(a__,b__) )
     #define CudaPreAlloc(a__,b__) HANDLE_ERROR( cudaPreAlloc(a__,b__) )
-    #define CudaAllocFinalize() HANDLE_ERROR( cudaAllocFinalize() )
+    #define CudaPreAllocSlabs(a__,b__,c__) HANDLE_ERROR( cudaPreAlloc(a__,b__,c__) )
+    #define CudaAllocFinalize(a__) HANDLE_ERROR( cudaAllocFinalize(a__) )
     #define CudaMallocHost(a__,b__) HANDLE_ERROR( cudaMallocHost(a__,b__) )
     #define CudaFree(a__) HANDLE_ERROR( cudaFree(a__) )
     #define CudaFreeHost(a__) HANDLE_ERROR( cudaFreeHost(a__) )
+    #define CudaAllocFree(a__) HANDLE_ERROR( cudaAllocFree(a__) )
     #define CudaAllocFreeAll() HANDLE_ERROR( cudaAllocFreeAll() )
 
     #define CudaDeviceCanAccessPeer(a__, b__, c__) HANDLE_ERROR( cudaDeviceCanAccessPeer(a__, b__, c__) )
@@ -132,6 +137,7 @@
 
     #define CudaMemcpyDeviceToHost hipMemcpyDeviceToHost
     #define CudaMemcpyHostToDevice hipMemcpyHostToDevice
+    #define CudaMemcpyDeviceToDevice hipMemcpyDeviceToDevice
     #define CudaCopyToConstant(a__,b__,c__,d__) HANDLE_ERROR( hipMemcpyToSymbol(b__, c__, d__, 0, hipMemcpyHostToDevice))
     #define CudaMemcpy2D(a__,b__,c__,d__,e__,f__,g__) HANDLE_ERROR( hipMemcpy2D(a__, b__, c__, d__, e__, f__, g__) )
     #define CudaMemcpy(a__,b__,c__,d__) HANDLE_ERROR( hipMemcpy(a__, b__, c__, d__) )
@@ -143,12 +149,16 @@
       #define CudaMemcpyPeerAsync(a__,b__,c__,d__,e__,f__) HANDLE_ERROR( hipMemcpyPeerAsync(a__, b__, c__, d__, e__, f__) )
     #endif
     #define CudaMemset(a__,b__,c__) HANDLE_ERROR( hipMemset(a__, b__, c__) )
+    #define CudaMemsetAsync(a__,b__,c__,d__) HANDLE_ERROR( hipMemsetAsync(a__, b__, c__, d__) )
+    #define CudaMemsetSlabs(a__,b__,c__,d__) CudaMemset(a__, b__, c__)
     #define CudaMalloc(a__,b__) HANDLE_ERROR( hipMalloc(a__,b__) )
     #define CudaPreAlloc(a__,b__) HANDLE_ERROR( cudaPreAlloc(a__,b__) )
-    #define CudaAllocFinalize() HANDLE_ERROR( cudaAllocFinalize() )
+    #define CudaPreAllocSlabs(a__,b__,c__) HANDLE_ERROR( cudaPreAlloc(a__,b__,c__) )
+    #define CudaAllocFinalize(a__) HANDLE_ERROR( cudaAllocFinalize(a__) )
     #define CudaMallocHost(a__,b__) HANDLE_ERROR( hipHostMalloc(a__,b__) )
     #define CudaFree(a__) HANDLE_ERROR( hipFree(a__) )
     #define CudaFreeHost(a__) HANDLE_ERROR( hipHostFree(a__) )
+    #define CudaAllocFree(a__) HANDLE_ERROR( cudaAllocFree(a__) )
     #define CudaAllocFreeAll() HANDLE_ERROR( cudaAllocFreeAll() )
 
     #define CudaDeviceCanAccessPeer(a__, b__, c__) HANDLE_ERROR( hipDeviceCanAccessPeer(a__, b__, c__) )
@@ -220,7 +230,9 @@
     #define CudaError int
     #define CudaSuccess -1
     #define CudaPreAlloc(a__,b__) HANDLE_ERROR( cudaPreAlloc(a__,b__) )
-    #define CudaAllocFinalize() HANDLE_ERROR( cudaAllocFinalize() )
+    #define CudaPreAllocSlabs(a__,b__,c__) HANDLE_ERROR( cudaPreAlloc(a__,b__,c__) )
+    #define CudaAllocFinalize(a__) HANDLE_ERROR( cudaAllocFinalize(a__) )
+    #define CudaAllocFree(a__) HANDLE_ERROR( cudaAllocFree(a__) )
     #define CudaAllocFreeAll() HANDLE_ERROR( cudaAllocFreeAll() )
 
     #define HANDLE_ERROR( err ) (assert( err == CudaSuccess ))
@@ -247,8 +259,10 @@
     #define CudaMemcpy(a__,b__,c__,d__) memcpy(a__, b__, c__)
     #define CudaMemcpyAsync(a__,b__,c__,d__,e__) CudaMemcpy(a__, b__, c__, d__)
     #define CudaMemset(a__,b__,c__) memset(a__, b__, c__)
-    #define CudaMalloc(a__,b__) assert( (*((void**)(a__)) = malloc(b__)) != NULL )
-    #define CudaMallocHost(a__,b__) assert( (*((void**)(a__)) = malloc(b__)) != NULL )
+    #define CudaMemsetAsync(a__,b__,c__,d__) memset(a__, b__, c__)
+    #define CudaMemsetSlabs(a__,b__,c__,d__) cpuMemsetSlabs(a__, b__, c__, d__)
+    #define CudaMalloc(a__,b__) assert( (*((void**)(a__)) = cpuMalloc(b__)) != NULL )
+    #define CudaMallocHost(a__,b__) assert( (*((void**)(a__)) = cpuMalloc(b__)) != NULL )
     #define CudaFree(a__) free(a__)
     #define CudaFreeHost(a__) free(a__)
 
@@ -307,6 +321,9 @@
     }
 
     void memcpy2D(void * dst_, int dpitch, const void * src_, int spitch, int width, int height);
+    void * cpuMalloc(size_t size);
+    void cpuMemsetSlabs(void * ptr, int value, size_t size, size_t slab);
+    void cpuReportPlacement(const void * ptr, size_t size);
 
     template <class T, class P> inline T data_cast(const P& x) {
       static_assert(sizeof(T)==sizeof(P),"Wrong sizes in data_cast");
@@ -330,6 +347,10 @@
       #pragma omp critical
       { if (val > sum[0]) sum[0] = val; }
     }
+    template <typename T> inline void CudaAtomicMin(T * sum, T val) {
+      #pragma omp critical
+      { if (val < sum[0]) sum[0] = val; }
+    }
     template <typename T> inline void CudaAtomicAddReduce(T * sum, T val) { CudaAtomicAdd(sum, val); }
     template <typename T> inline void CudaAtomicAddReduceWarp(T * sum, T val) { CudaAtomicAdd(sum, val); }
     template <typename T> inline void CudaAtomicAddReduceDiff(T * sum, T val, bool yes) { if (yes) CudaAtomicAdd(sum, val); }
@@ -345,8 +366,9 @@
 
   #endif
 
-  CudaError cudaPreAlloc(void ** ptr, size_t size);
-  CudaError cudaAllocFinalize();
+  CudaError cudaPreAlloc(void ** ptr, size_t size, size_t slab = 0);
+  CudaError cudaAllocFinalize(void ** block = NULL);
+  CudaError cudaAllocFree(void * block);
   CudaError cudaAllocFreeAll();
 
 #endif // CROSS_H
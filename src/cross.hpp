@@ -76,6 +76,7 @@
       
   #define CudaAtomicAdd atomicAdd
   #define CudaAtomicMax atomicMax
+  #define CudaAtomicMin atomicMin
 
   #ifndef MAX_THREADS
     #error FUCK!
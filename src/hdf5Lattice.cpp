@@ -5,6 +5,7 @@
 #include "hdf5Lattice.h"
 #include "Global.h"
 #include "glue.hpp"
+#include <algorithm>
 
 #ifdef WITH_HDF5
 	#include <hdf5.h>
@@ -23,7 +24,7 @@ std::string NameXPath(const pugi::xml_node& node) {
 	return path;
 }
 
-int hdf5WriteLattice(const char * nm, Solver * solver, name_set * what, unsigned long int * chunkdim_, unsigned int options, lbRegion total_output_reg)
+int hdf5WriteLattice(const char * nm, Solver * solver, name_set * what, unsigned long int * chunkdim_, unsigned int options, lbRegion total_output_reg, int stride, bool average)
 {
 #ifdef WITH_HDF5
 	Glue glue;
@@ -44,6 +45,14 @@ int hdf5WriteLattice(const char * nm, Solver * solver, name_set * what, unsigned
 	size_t size;
 	lbRegion local_reg = lattice->region;
 	lbRegion reg = local_reg.intersect(total_output_reg);
+	lbRegion file_reg = total_output_reg;
+	if (stride > 1) {
+		// Boxes of stride^3 nodes are the cells of the file
+		reg = local_reg.coarse(total_output_reg, stride);
+		file_reg = total_output_reg.coarse(total_output_reg, stride);
+	} else {
+		stride = 1;
+	}
 	size = reg.size();
 
 	myprint(1,-1,"Writing region %dx%dx%d + %d,%d,%d (size %d) from %dx%dx%d + %d,%d,%d", 
@@ -71,16 +80,34 @@ int hdf5WriteLattice(const char * nm, Solver * solver, name_set * what, unsigned
 	xdmf_dataitem.append_attribute("Format") = "XML";
 	xdmf_dataitem.append_attribute("Precision") = 8;
 	{
-		double shift = 0.0;
-		if (options & HDF5_WRITE_POINT) shift = 0.5;
-		xdmf_dataitem.append_child(pugi::node_pcdata).set_value(glue(" ") << (lattice->pz + shift + total_output_reg.dz)/unit << (lattice->py + shift + total_output_reg.dy)/unit << (lattice->px + shift + total_output_reg.dx)/unit);
+		// Averaged values are placed at the center of their box, sampled values at its first node:
+		//  as points at these positions, or as cells covering the box (averaged) or centered on the node (sampled)
+		double sx, sy, sz;
+		if (options & HDF5_WRITE_POINT) {
+			if (average) {
+				sx = 0.5*std::min(stride, total_output_reg.nx);
+				sy = 0.5*std::min(stride, total_output_reg.ny);
+				sz = 0.5*std::min(stride, total_output_reg.nz);
+			} else {
+				sx = sy = sz = 0.5;
+			}
+		} else {
+			if (average) {
+				sx = 0.5*(std::min(stride, total_output_reg.nx)-stride);
+				sy = 0.5*(std::min(stride, total_output_reg.ny)-stride);
+				sz = 0.5*(std::min(stride, total_output_reg.nz)-stride);
+			} else {
+				sx = sy = sz = -0.5*(stride-1);
+			}
+		}
+		xdmf_dataitem.append_child(pugi::node_pcdata).set_value(glue(" ") << (lattice->pz + sz + total_output_reg.dz)/unit << (lattice->py + sy + total_output_reg.dy)/unit << (lattice->px + sx + total_output_reg.dx)/unit);
 	}
 	xdmf_dataitem = xdmf_geometry.append_child("DataItem");
 	xdmf_dataitem.append_attribute("DataType") = "Float";
 	xdmf_dataitem.append_attribute("Dimensions") = "3";
 	xdmf_dataitem.append_attribute("Format") = "XML";
 	xdmf_dataitem.append_attribute("Precision") = 8;
-	xdmf_dataitem.append_child(pugi::node_pcdata).set_value(glue(" ") << 1/unit << 1/unit << 1/unit);
+	xdmf_dataitem.append_child(pugi::node_pcdata).set_value(glue(" ") << stride/unit << stride/unit << stride/unit);
 	
 	hid_t       file_id, dset_id;         /* file and dataset identifiers */
 	hsize_t     totaldim[4];                 /* dataset dimensions */
@@ -101,22 +128,22 @@ int hdf5WriteLattice(const char * nm, Solver * solver, name_set * what, unsigned
 	ones[2] = 1;
 	ones[3] = 1;
 
-	totaldim[0] = total_output_reg.nz;
-	totaldim[1] = total_output_reg.ny;
-	totaldim[2] = total_output_reg.nx;
+	totaldim[0] = file_reg.nz;
+	totaldim[1] = file_reg.ny;
+	totaldim[2] = file_reg.nx;
 	totaldim[3] = 3;
 	dim[0] = reg.nz;   
 	dim[1] = reg.ny;   
 	dim[2] = reg.nx;
 	dim[3] = 3;
-	offset[0] = reg.dz - total_output_reg.dz;
-	offset[1] = reg.dy - total_output_reg.dy;
-	offset[2] = reg.dx - total_output_reg.dx;
+	offset[0] = reg.dz - file_reg.dz;
+	offset[1] = reg.dy - file_reg.dy;
+	offset[2] = reg.dx - file_reg.dx;
 	offset[3] = 0;
 
-	totalpointdim[0] = total_output_reg.nz+1;
-	totalpointdim[1] = total_output_reg.ny+1;
-	totalpointdim[2] = total_output_reg.nx+1;
+	totalpointdim[0] = file_reg.nz+1;
+	totalpointdim[1] = file_reg.ny+1;
+	totalpointdim[2] = file_reg.nx+1;
 
 
 	MPI_Comm comm  = MPMD.local;
@@ -158,7 +185,11 @@ int hdf5WriteLattice(const char * nm, Solver * solver, name_set * what, unsigned
 	
 
 	flag_t * NodeType = new flag_t[size];
-	lattice->GetFlags(reg, NodeType);
+	if (stride > 1) {
+		lattice->GetFlags(total_output_reg, NodeType, stride);
+	} else {
+		lattice->GetFlags(reg, NodeType);
+	}
 	for (const Model::NodeTypeGroupFlag& it : lattice->model->nodetypegroupflags) {
 		hid_t       filespace, memspace;
 		const char * fieldname = it.name.c_str();
@@ -275,7 +306,11 @@ int hdf5WriteLattice(const char * nm, Solver * solver, name_set * what, unsigned
 			int comp = 1;
 			if (vector) comp = 3;
 	                real_t* tmp = new real_t[size*comp];
-                        lattice->GetQuantity(it.id, reg, tmp, 1/unit);
+			if (stride > 1) {
+				lattice->GetQuantity(it.id, total_output_reg, tmp, 1/unit, stride, average);
+			} else {
+	                        lattice->GetQuantity(it.id, reg, tmp, 1/unit);
+			}
 
 			myprint(0,-1,"filespace: %lld memsize: %lld\n", H5Sget_select_npoints(filespace), H5Sget_select_npoints(memspace));
 			plist_id = H5Pcreate(H5P_DATASET_XFER);
@@ -5,12 +5,69 @@
 #include "vtkLattice.h"
 //#include <unistd.h>
 #include "Global.h"
+#include <vector>
+#include <algorithm>
+#include <math.h>
 
-int vtkWriteLattice(char * filename, Lattice * lattice, UnitEnv units, name_set * what, lbRegion total_output_reg)
+/// Writes a field compressed with the BlockCompressor, and reports the ratio and the error
+static void vtkWriteCompressed(vtkFileOut& vtkFile, const char * name, real_t * tmp, lbRegion reg, int comp, const BlockCompressor * codec)
+{
+	size_t n = reg.size() * comp;
+	std::vector<double> field(tmp, tmp + n);
+	std::vector<unsigned char> data;
+	codec->Compress(field.data(), reg.nx, reg.ny, reg.nz, comp, data);
+#ifndef CALC_DOUBLE_PRECISION
+	vtkFile.WriteCompressedField(name, data.data(), data.size(), "Float32", comp, "BlockCompressor");
+#else
+	vtkFile.WriteCompressedField(name, data.data(), data.size(), "Float64", comp, "BlockCompressor");
+#endif
+	std::vector<double> check(n);
+	double err = 0;
+	if (BlockCompressor::Decompress(data.data(), data.size(), reg.nx, reg.ny, reg.nz, comp, check.data())) {
+		ERROR("Compressed %s cannot be decompressed\n", name);
+		err = -1;
+	} else {
+		for (size_t i=0; i<n; i++) err = std::max(err, fabs(check[i] - field[i]));
+	}
+	double sizes[2] = { (double) (n * sizeof(real_t)), (double) data.size() };
+	double all_sizes[2], all_err, min_err;
+	MPI_Reduce(sizes, all_sizes, 2, MPI_DOUBLE, MPI_SUM, 0, MPMD.local);
+	MPI_Reduce(&err, &all_err, 1, MPI_DOUBLE, MPI_MAX, 0, MPMD.local);
+	MPI_Reduce(&err, &min_err, 1, MPI_DOUBLE, MPI_MIN, 0, MPMD.local);
+	if (min_err < 0) {
+		output("Compressed %s: ratio %.2lf, error not available\n", name, all_sizes[0] / all_sizes[1]);
+	} else {
+		output("Compressed %s: ratio %.2lf, max error %lg\n", name, all_sizes[0] / all_sizes[1], all_err);
+	}
+}
+
+int vtkWriteLattice(char * filename, Lattice * lattice, UnitEnv units, name_set * what, lbRegion total_output_reg, name_set * compress, const BlockCompressor * codec, int stride, bool average)
 {
 	size_t size;
 	lbRegion local_reg = lattice->region;
 	lbRegion reg = local_reg.intersect(total_output_reg);
+	lbRegion file_reg = total_output_reg;
+	double spacing = 1/units.alt("m");
+	double ox = lattice->px*spacing, oy = lattice->py*spacing, oz = lattice->pz*spacing;
+	if (stride > 1) {
+		// Boxes of stride^3 nodes are the cells of the file
+		reg = local_reg.coarse(total_output_reg, stride);
+		file_reg = total_output_reg.coarse(total_output_reg, stride);
+		// The values are CellData: an averaged cell covers the nodes of its box,
+		//  a sampled cell is centered on the first node of its box
+		double sx, sy, sz;
+		if (average) {
+			sx = 0.5*(std::min(stride, total_output_reg.nx)-stride);
+			sy = 0.5*(std::min(stride, total_output_reg.ny)-stride);
+			sz = 0.5*(std::min(stride, total_output_reg.nz)-stride);
+		} else {
+			sx = sy = sz = -0.5*(stride-1);
+		}
+		ox = (lattice->px + total_output_reg.dx + sx)*spacing;
+		oy = (lattice->py + total_output_reg.dy + sy)*spacing;
+		oz = (lattice->pz + total_output_reg.dz + sz)*spacing;
+		spacing = spacing * stride;
+	}
 	size = reg.size();
 	myprint(1,-1,"Writing region %dx%dx%d + %d,%d,%d (size %d) from %dx%dx%d + %d,%d,%d",
 		reg.nx,reg.ny,reg.nz,reg.dx,reg.dy,reg.dz, size,
@@ -18,11 +75,14 @@ int vtkWriteLattice(char * filename, Lattice * lattice, UnitEnv units, name_set
 
 	vtkFileOut vtkFile(MPMD.local);
 	if (vtkFile.Open(filename)) {return -1;}
-	double spacing = 1/units.alt("m");
-	vtkFile.Init(total_output_reg, reg, "Scalars=\"rho\" Vectors=\"velocity\"", spacing, lattice->px*spacing, lattice->py*spacing, lattice->pz*spacing);
+	vtkFile.Init(file_reg, reg, "Scalars=\"rho\" Vectors=\"velocity\"", spacing, ox, oy, oz);
 
 	{	flag_t * NodeType = new flag_t[size];
-		lattice->GetFlags(reg, NodeType);
+		if (stride > 1) {
+			lattice->GetFlags(total_output_reg, NodeType, stride);
+		} else {
+			lattice->GetFlags(reg, NodeType);
+		}
 		if (what->explicitlyIn("flag")) {
 			vtkFile.WriteField("flag",NodeType);
 		}
@@ -45,8 +105,16 @@ int vtkWriteLattice(char * filename, Lattice * lattice, UnitEnv units, name_set
 			int comp = 1;
 			if (it.isVector) comp = 3;
 	                real_t* tmp = new real_t[size*comp];
-                        lattice->GetQuantity(it.id, reg, tmp, 1/v);
-			vtkFile.WriteField(it.name.c_str(), tmp, comp);
+			if (stride > 1) {
+				lattice->GetQuantity(it.id, total_output_reg, tmp, 1/v, stride, average);
+			} else {
+	                        lattice->GetQuantity(it.id, reg, tmp, 1/v);
+			}
+			if (codec != NULL && compress->in(it.name)) {
+				vtkWriteCompressed(vtkFile, it.name.c_str(), tmp, reg, comp, codec);
+			} else {
+				vtkFile.WriteField(it.name.c_str(), tmp, comp);
+			}
 			delete[] tmp;
 		}
 	}
@@ -6,8 +6,9 @@
 	#include "vtkOutput.h"
 	#include "unit.h"
 	#include "utils.h"
+	#include "BlockCompress.h"
 
-	int vtkWriteLattice(char * filename, Lattice * lattice, UnitEnv, name_set * s, lbRegion region);
+	int vtkWriteLattice(char * filename, Lattice * lattice, UnitEnv, name_set * s, lbRegion region, name_set * compress = NULL, const BlockCompressor * codec = NULL, int stride = 1, bool average = false);
 	int binWriteLattice(char * filename, Lattice * lattice, UnitEnv units);
 	int txtWriteLattice(char * filename, Lattice * lattice, UnitEnv, name_set * s, int type);
 	void screenDumpLattice(Lattice * lattice);
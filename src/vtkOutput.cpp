@@ -43,9 +43,12 @@ void fprintB64(FILE* f, void * tab, int len)
 //const char * vtk_header       = "<?xml version=\"1.0\"?>\n<VTKFile type=\"ImageData\" version=\"0.1\" byte_order=\"LittleEndian\">\n<ImageData WholeExtent=\"0 %d 0 %d 0 %d\" Origin=\"0 0 0\" Spacing=\"0.005 0.005 0.005\">\n<Piece Extent=\"0 %d 0 %d 0 %d\">\n<PointData %s>\n";
 // order of % arguments: datatype fieldname
 const char * vtk_field_header = "<DataArray type=\"%s\" Name=\"%s\" format=\"binary\" encoding=\"base64\" NumberOfComponents=\"%d\">\n";
+// order of % arguments: fieldname compression length datatype fieldname components compression
+const char * vtk_compressed_field_header = "<DataArray type=\"UInt8\" Name=\"%s.%s\" format=\"binary\" encoding=\"base64\" NumberOfComponents=\"1\" NumberOfTuples=\"%d\" FieldType=\"%s\" FieldName=\"%s\" FieldComponents=\"%d\" compression=\"%s\">\n";
 const char * vtk_field_footer = "</DataArray>\n";
 const char * vtk_field_parallel = "<PDataArray type=\"%s\" Name=\"%s\" format=\"binary\" encoding=\"base64\" NumberOfComponents=\"%d\"/>\n";
-const char * vtk_footer       = "</CellData>\n</Piece>\n</ImageData>\n</VTKFile>\n";
+const char * vtk_footer       = "</CellData>\n</Piece>\n";
+const char * vtk_final_footer = "</ImageData>\n</VTKFile>\n";
 
 // Error handler
 #define FERR 	if (f == NULL) {fprintf(stderr, "Error: vtkOutput tried to write before opening a file\n"); return; } 
@@ -169,9 +172,36 @@ void vtkFileOut::WriteField(const char * name, void * data, int elem, const char
 	}
 };
 
+// Compressed streams are not cell data: they are stored as opaque UInt8 arrays
+// in the FieldData of the piece, so that standard readers cannot take them for floats
+void vtkFileOut::WriteCompressedField(const char * name, void * data, int len, const char * tp, int components, const char * compression) {
+	FERR;
+	CompressedField field;
+	field.name = name;
+	field.tp = tp;
+	field.components = components;
+	field.compression = compression;
+	field.data.assign((unsigned char*) data, (unsigned char*) data + len);
+	compressed.push_back(field);
+};
+
 void vtkFileOut::Finish() {
 	FERR;
 	fprintf(f, "%s", vtk_footer);
+	if (compressed.size() > 0) {
+		fprintf(f, "<FieldData>\n");
+		for (CompressedField& it : compressed) {
+			int len = it.data.size();
+			fprintf(f, vtk_compressed_field_header, it.name.c_str(), it.compression.c_str(), len, it.tp.c_str(), it.name.c_str(), it.components, it.compression.c_str());
+			WriteB64(&len, sizeof(int));
+			WriteB64(it.data.data(), len);
+			fprintf(f, "\n");
+			fprintf(f, "%s", vtk_field_footer);
+		}
+		fprintf(f, "</FieldData>\n");
+		compressed.clear();
+	}
+	fprintf(f, "%s", vtk_final_footer);
 	if (fp != NULL) {
 		fprintf(fp, "</PCellData>\n</PImageData>\n</VTKFile>\n");
 	}
@@ -3,6 +3,8 @@
 #include "cross.h"
 #include "types.h"
 #include "Region.h"
+#include <string>
+#include <vector>
 void fprintB64(FILE* f, void * tab, int len);
 
 class vtkFileOut {
@@ -12,6 +14,12 @@ class vtkFileOut {
 	int parallel;
 	int size;
 	MPI_Comm comm;
+	struct CompressedField {
+		std::string name, tp, compression;
+		int components;
+		std::vector<unsigned char> data;
+	};
+	std::vector<CompressedField> compressed; ///< Compressed fields, written as opaque FieldData on Finish
 public:
 	vtkFileOut (MPI_Comm comm_=MPI_COMM_WORLD);
 	int Open(const char* filename);
@@ -22,6 +30,7 @@ public:
 	inline void Init(lbRegion tot, lbRegion region, char* selection, double spacing) { Init( tot, region, selection, spacing, 0.0, 0.0, 0.0); }
 	void Init(int width, int height);
 	void WriteField(const char * name, void * data, int elem, const char * tp, int components);
+	void WriteCompressedField(const char * name, void * data, int len, const char * tp, int components, const char * compression);
 	inline void WriteField(const char * name, float * data) { WriteField(name, (void*) data, sizeof(float), "Float32", 1); };
 	inline void WriteField(const char * name, float * data, int comp) { WriteField(name, (void*) data, sizeof(float)*comp, "Float32", comp); };
 	inline void WriteField(const char * name, float2 * data) { WriteField(name, (void*) data, sizeof(float2), "Float32", 2); };